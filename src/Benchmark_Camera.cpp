@@ -0,0 +1,626 @@
+
+/* INCLUDES FOR THIS PROJECT */
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <map>
+#include <opencv2/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/features2d.hpp>
+
+#include "dataStructures.h"
+#include "matching2D.hpp"
+#include "simdFeatures.hpp"
+#include "lshIndex.hpp"
+#include "hnswIndex.hpp"
+#include "trackManager.hpp"
+
+using namespace std;
+
+// Reference Harris detector with the former O(pixels x keypoints) overlap-based non-maximum suppression
+static double detKeypointsHarrisReference(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img)
+{
+    int blockSize = 4;
+    int apertureSize = 3;
+    int minResponse = 100;
+    double k = 0.04;
+
+    cv::Mat dst, dst_norm;
+    dst = cv::Mat::zeros(img.size(), CV_32FC1);
+
+    double t = (double)cv::getTickCount();
+    cv::cornerHarris(img, dst, blockSize, apertureSize, k, cv::BORDER_DEFAULT);
+    cv::normalize(dst, dst_norm, 0, 255, cv::NORM_MINMAX, CV_32FC1, cv::Mat());
+
+    double maxOverlap = 0.0;
+    for (size_t j = 0; j < dst_norm.rows; j++)
+    {
+        for (size_t i = 0; i < dst_norm.cols; i++)
+        {
+            int response = (int)dst_norm.at<float>(j, i);
+            if (response > minResponse)
+            {
+                cv::KeyPoint newKeyPoint;
+                newKeyPoint.pt = cv::Point2f(i, j);
+                newKeyPoint.size = 2 * apertureSize;
+                newKeyPoint.response = response;
+
+                bool bOverlap = false;
+                for (auto it = keypoints.begin(); it != keypoints.end(); ++it)
+                {
+                    double kptOverlap = cv::KeyPoint::overlap(newKeyPoint, *it);
+                    if (kptOverlap > maxOverlap)
+                    {
+                        bOverlap = true;
+                        if (newKeyPoint.response > (*it).response)
+                        {
+                            *it = newKeyPoint;
+                            break;
+                        }
+                    }
+                }
+                if (!bOverlap)
+                {
+                    keypoints.push_back(newKeyPoint);
+                }
+            }
+        }
+    }
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    return t;
+}
+
+// Compare the grid/dilation based Harris NMS against the reference implementation
+static void benchHarrisNms(vector<cv::Mat> &imgsGray)
+{
+    double tRef = 0.0, tNew = 0.0;
+    size_t nRef = 0, nNew = 0;
+    for (auto &img : imgsGray)
+    {
+        vector<cv::KeyPoint> kptsRef, kptsNew;
+        tRef += detKeypointsHarrisReference(kptsRef, img);
+        tNew += detKeypointsHarris(kptsNew, img, false);
+        nRef += kptsRef.size();
+        nNew += kptsNew.size();
+    }
+    double nImgs = (double)imgsGray.size();
+    cout << "HARRIS NMS : reference " << 1000 * tRef / nImgs << " ms/frame (" << nRef / nImgs << " kpts), "
+         << "dilation+grid " << 1000 * tNew / nImgs << " ms/frame (" << nNew / nImgs << " kpts), "
+         << "speedup " << tRef / tNew << "x" << endl;
+}
+
+// Compare full-image detection against tile-parallel detection for the corner detectors
+static void benchTiledDetection(vector<cv::Mat> &imgsGray)
+{
+    vector<string> detectorTypes = {"FAST", "SHITOMASI", "HARRIS"};
+    for (auto &detectorType : detectorTypes)
+    {
+        double tFull = 0.0, tTiled = 0.0;
+        size_t nFull = 0, nTiled = 0;
+        for (auto &img : imgsGray)
+        {
+            vector<cv::KeyPoint> kptsFull, kptsTiled;
+            if (detectorType.compare("SHITOMASI") == 0)
+            {
+                tFull += detKeypointsShiTomasi(kptsFull, img, false);
+            }
+            else if (detectorType.compare("HARRIS") == 0)
+            {
+                tFull += detKeypointsHarris(kptsFull, img, false);
+            }
+            else
+            {
+                tFull += detKeypointsModern(kptsFull, img, detectorType, false);
+            }
+            tTiled += detKeypointsTiled(kptsTiled, img, detectorType, 4, 2, 16);
+            nFull += kptsFull.size();
+            nTiled += kptsTiled.size();
+        }
+        double nImgs = (double)imgsGray.size();
+        cout << "TILED " << detectorType << " (" << cv::getNumThreads() << " threads) : full image " << 1000 * tFull / nImgs << " ms/frame ("
+             << nFull / nImgs << " kpts), tiled " << 1000 * tTiled / nImgs << " ms/frame (" << nTiled / nImgs << " kpts), "
+             << "speedup " << tFull / tTiled << "x" << endl;
+    }
+}
+
+// Compare the hand-written FAST-9 detector against cv::FastFeatureDetector with the same threshold and NMS
+static void benchFastSimd(vector<cv::Mat> &imgsGray)
+{
+    int threshold = 30;
+    cv::Ptr<cv::FastFeatureDetector> detector = cv::FastFeatureDetector::create(threshold, true, cv::FastFeatureDetector::TYPE_9_16);
+    double tRef = 0.0, tSimd = 0.0;
+    size_t nRef = 0, nSimd = 0, nCommon = 0;
+    for (auto &img : imgsGray)
+    {
+        vector<cv::KeyPoint> kptsRef, kptsSimd;
+        double t = (double)cv::getTickCount();
+        detector->detect(img, kptsRef);
+        tRef += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+
+        t = (double)cv::getTickCount();
+        detectFastSimd(kptsSimd, img, threshold);
+        tSimd += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+
+        // agreement : keypoints found at the same pixel by both detectors
+        cv::Mat hits = cv::Mat::zeros(img.size(), CV_8UC1);
+        for (auto &kpt : kptsRef)
+        {
+            hits.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x)) = 1;
+        }
+        for (auto &kpt : kptsSimd)
+        {
+            nCommon += hits.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x));
+        }
+        nRef += kptsRef.size();
+        nSimd += kptsSimd.size();
+    }
+    double nImgs = (double)imgsGray.size();
+#ifdef __AVX2__
+    string variant = "AVX2";
+#else
+    string variant = "scalar";
+#endif
+    cout << "FAST_SIMD (" << variant << ") : cv::FastFeatureDetector " << 1000 * tRef / nImgs << " ms/frame (" << nRef / nImgs << " kpts), "
+         << "FAST_SIMD " << 1000 * tSimd / nImgs << " ms/frame (" << nSimd / nImgs << " kpts), "
+         << "speedup " << tRef / tSimd << "x, agreement " << 100.0 * nCommon / max<size_t>(1, max(nRef, nSimd)) << "%" << endl;
+}
+
+// Compare the built-in BRIEF extractor (SIMD and scalar path) against cv::xfeatures2d::BriefDescriptorExtractor
+// on FAST keypoints. Both use the same sampling pattern, so every descriptor must be bit-identical to the reference
+// descriptor of the same keypoint; keypoints kept by only one side at the image border are counted separately.
+static void benchBriefSimd(vector<cv::Mat> &imgsGray)
+{
+    cv::Ptr<cv::DescriptorExtractor> extractorRef = cv::xfeatures2d::BriefDescriptorExtractor::create(32);
+    cv::Ptr<cv::DescriptorExtractor> extractorScalar = BriefSimdExtractor::create(false);
+    cv::Ptr<cv::DescriptorExtractor> extractorSimd = BriefSimdExtractor::create(true);
+    double tRef = 0.0, tScalar = 0.0, tSimd = 0.0;
+    size_t nKpts = 0, nMismatch = 0, nMismatchRef = 0, nUnmatched = 0;
+    for (auto &img : imgsGray)
+    {
+        vector<cv::KeyPoint> keypoints;
+        detectFastSimd(keypoints, img, 30);
+        vector<cv::KeyPoint> kptsRef = keypoints, kptsScalar = keypoints, kptsSimd = keypoints;
+        cv::Mat descRef, descScalar, descSimd;
+
+        double t = (double)cv::getTickCount();
+        extractorRef->compute(img, kptsRef, descRef);
+        tRef += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+
+        t = (double)cv::getTickCount();
+        extractorScalar->compute(img, kptsScalar, descScalar);
+        tScalar += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+
+        t = (double)cv::getTickCount();
+        extractorSimd->compute(img, kptsSimd, descSimd);
+        tSimd += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+
+        map<pair<float, float>, int> refRows; // reference descriptor row by keypoint position
+        for (int i = 0; i < (int)kptsRef.size(); i++)
+        {
+            refRows[make_pair(kptsRef[i].pt.x, kptsRef[i].pt.y)] = i;
+        }
+        size_t nCommon = 0;
+        for (int i = 0; i < descSimd.rows; i++)
+        {
+            nMismatch += cv::norm(descSimd.row(i), descScalar.row(i), cv::NORM_HAMMING) > 0 ? 1 : 0;
+            auto it = refRows.find(make_pair(kptsSimd[i].pt.x, kptsSimd[i].pt.y));
+            if (it != refRows.end())
+            {
+                nCommon++;
+                nMismatchRef += cv::norm(descSimd.row(i), descRef.row(it->second), cv::NORM_HAMMING) > 0 ? 1 : 0;
+            }
+        }
+        nUnmatched += (kptsSimd.size() - nCommon) + (kptsRef.size() - min(kptsRef.size(), nCommon));
+        nKpts += kptsSimd.size();
+    }
+    double nImgs = (double)imgsGray.size();
+    cout << "BRIEF_SIMD (" << nKpts / nImgs << " kpts/frame) : cv::xfeatures2d BRIEF " << 1000 * tRef / nImgs << " ms/frame, "
+         << "scalar " << 1000 * tScalar / nImgs << " ms/frame, SIMD " << 1000 * tSimd / nImgs << " ms/frame, "
+         << "speedup " << tRef / tSimd << "x, " << nMismatchRef << " descriptors differ from cv::xfeatures2d BRIEF, " << nMismatch
+         << " from scalar, " << nUnmatched << " border keypoints kept by one side only" << endl;
+    CV_Assert(nMismatchRef == 0 && nMismatch == 0);
+}
+
+// Compare cv::BFMatcher (MAT_BF) against another brute force matcher type with kNN ratio test on consecutive frame pairs
+static void compareWithBFMatcher(string label, vector<vector<cv::KeyPoint>> &keypoints, vector<cv::Mat> &descriptors,
+                                 string descriptorType, string matcherType)
+{
+    double tRef = 0.0, tNew = 0.0;
+    size_t nRef = 0, nNew = 0, nAgree = 0;
+    for (size_t i = 0; i + 1 < descriptors.size(); ++i)
+    {
+        vector<cv::DMatch> matchesRef, matchesNew;
+        double t = (double)cv::getTickCount();
+        matchDescriptors(keypoints[i], keypoints[i + 1], descriptors[i], descriptors[i + 1], matchesRef, descriptorType, "MAT_BF", "SEL_KNN");
+        tRef += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+
+        t = (double)cv::getTickCount();
+        matchDescriptors(keypoints[i], keypoints[i + 1], descriptors[i], descriptors[i + 1], matchesNew, descriptorType, matcherType, "SEL_KNN");
+        tNew += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+
+        map<int, int> reference;
+        for (auto &match : matchesRef)
+        {
+            reference[match.queryIdx] = match.trainIdx;
+        }
+        for (auto &match : matchesNew)
+        {
+            auto it = reference.find(match.queryIdx);
+            nAgree += (it != reference.end() && it->second == match.trainIdx) ? 1 : 0;
+        }
+        nRef += matchesRef.size();
+        nNew += matchesNew.size();
+    }
+    double nPairs = (double)(descriptors.size() - 1);
+    cout << label << " : MAT_BF " << 1000 * tRef / nPairs << " ms/pair (" << nRef / nPairs << " matches), " << matcherType << " "
+         << 1000 * tNew / nPairs << " ms/pair (" << nNew / nPairs << " matches), speedup " << tRef / tNew << "x, agreement "
+         << 100.0 * nAgree / max<size_t>(1, nRef) << "%" << endl;
+}
+
+// Detect and describe all frames with one of the fused feature types
+static void detectAndDescribeAll(vector<cv::Mat> &imgsGray, string featureType, vector<vector<cv::KeyPoint>> &keypoints, vector<cv::Mat> &descriptors)
+{
+    cv::Ptr<cv::Feature2D> engine = getDetector(featureType);
+    keypoints.assign(imgsGray.size(), vector<cv::KeyPoint>());
+    descriptors.assign(imgsGray.size(), cv::Mat());
+    for (size_t i = 0; i < imgsGray.size(); ++i)
+    {
+        engine->detectAndCompute(imgsGray[i], cv::noArray(), keypoints[i], descriptors[i]);
+    }
+}
+
+// Compare float SIFT matching against uint8 SIFT, RootSIFT and PCA-reduced RootSIFT with the integer L2 kernel.
+// The PCA is fitted on the first half of the frames, written to pcaFile for use in the tracking pipeline if
+// a file is given, and all variants are evaluated on consecutive frame pairs of the second half.
+static void benchQuantizedSift(vector<cv::Mat> &imgsGray, string pcaFile)
+{
+    size_t nImgs = imgsGray.size();
+    vector<vector<cv::KeyPoint>> keypoints;
+    vector<cv::Mat> descriptors;
+    detectAndDescribeAll(imgsGray, "SIFT", keypoints, descriptors);
+
+    size_t nFit = nImgs / 2;
+    cv::Mat samples;
+    for (size_t i = 0; i < nFit; ++i)
+    {
+        samples.push_back(descriptors[i]);
+    }
+    SiftQuantizer pcaQuantizer(true);
+    fitSiftPca(pcaQuantizer, samples, 64);
+    if (!pcaFile.empty())
+    {
+        saveSiftPca(pcaQuantizer, pcaFile);
+    }
+
+    vector<string> variants = {"FLOAT", "U8", "ROOTSIFT_U8", "ROOTSIFT_PCA64_U8"};
+    vector<SiftQuantizer> quantizers = {SiftQuantizer(false), SiftQuantizer(false), SiftQuantizer(true), pcaQuantizer};
+    vector<map<int, int>> referenceMatches; // float path matches per frame pair, source index -> reference index
+    for (size_t v = 0; v < variants.size(); ++v)
+    {
+        double tMatch = 0.0, bytes = 0.0;
+        size_t nMatches = 0, nAgree = 0, nReference = 0;
+        for (size_t i = nFit; i + 1 < nImgs; ++i)
+        {
+            cv::Mat descPrev = descriptors[i].clone(), descCurr = descriptors[i + 1].clone();
+            if (v > 0)
+            {
+                quantizeSiftDescriptors(descPrev, quantizers[v]);
+                quantizeSiftDescriptors(descCurr, quantizers[v]);
+            }
+            bytes += descCurr.total() * descCurr.elemSize();
+
+            vector<cv::DMatch> matches;
+            double t = (double)cv::getTickCount();
+            matchDescriptors(keypoints[i], keypoints[i + 1], descPrev, descCurr, matches, v > 0 ? "DES_HOG_U8" : "DES_HOG", "MAT_BF", "SEL_KNN");
+            tMatch += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+            nMatches += matches.size();
+
+            if (v == 0)
+            {
+                map<int, int> pairMatches;
+                for (auto &match : matches)
+                {
+                    pairMatches[match.queryIdx] = match.trainIdx;
+                }
+                referenceMatches.push_back(pairMatches);
+            }
+            map<int, int> &reference = referenceMatches[i - nFit];
+            nReference += reference.size();
+            for (auto &match : matches)
+            {
+                auto it = reference.find(match.queryIdx);
+                nAgree += (it != reference.end() && it->second == match.trainIdx) ? 1 : 0;
+            }
+        }
+        double nPairs = (double)(nImgs - 1 - nFit);
+        cout << "QUANT_SIFT " << variants[v] << " : " << bytes / nPairs / 1024 << " kB/frame, match " << 1000 * tMatch / nPairs << " ms/pair ("
+             << nMatches / nPairs << " matches), agreement with float " << 100.0 * nAgree / max<size_t>(1, nReference) << "%" << endl;
+    }
+}
+
+// Compare cv::BFMatcher against the blocked popcount matcher (MAT_HAMMING) for 32 and 64 byte descriptors
+static void benchHammingMatcher(vector<cv::Mat> &imgsGray)
+{
+    vector<string> descriptorTypes = {"ORB", "BRISK"};
+    for (auto &descriptorType : descriptorTypes)
+    {
+        vector<vector<cv::KeyPoint>> keypoints;
+        vector<cv::Mat> descriptors;
+        detectAndDescribeAll(imgsGray, descriptorType, keypoints, descriptors);
+        compareWithBFMatcher("HAMMING " + descriptorType, keypoints, descriptors, "DES_BINARY", "MAT_HAMMING");
+    }
+}
+
+// Compare cv::BFMatcher against the blocked matrix multiply matcher (MAT_GEMM) for SIFT descriptors
+static void benchGemmMatcher(vector<cv::Mat> &imgsGray)
+{
+    vector<vector<cv::KeyPoint>> keypoints;
+    vector<cv::Mat> descriptors;
+    detectAndDescribeAll(imgsGray, "SIFT", keypoints, descriptors);
+    compareWithBFMatcher("GEMM SIFT", keypoints, descriptors, "DES_HOG", "MAT_GEMM");
+}
+
+// Compare cv::BFMatcher against the FLANN LSH index (MAT_FLANN) and the multi-probe LSH index (MAT_LSH) for 32 and
+// 64 byte descriptors; agreement with MAT_BF is the recall of the approximate matchers. Then keep a sliding window
+// of the last windowSize frames in one LshIndex, inserting the newest and removing the oldest frame per step in place.
+static void benchLshMatcher(vector<cv::Mat> &imgsGray)
+{
+    vector<string> descriptorTypes = {"ORB", "BRISK"};
+    size_t windowSize = 3;
+    for (auto &descriptorType : descriptorTypes)
+    {
+        vector<vector<cv::KeyPoint>> keypoints;
+        vector<cv::Mat> descriptors;
+        detectAndDescribeAll(imgsGray, descriptorType, keypoints, descriptors);
+        compareWithBFMatcher("FLANN " + descriptorType, keypoints, descriptors, "DES_BINARY", "MAT_FLANN");
+        compareWithBFMatcher("LSH " + descriptorType, keypoints, descriptors, "DES_BINARY", "MAT_LSH");
+
+        LshIndex index(descriptors[0].cols);
+        vector<vector<int>> windowIds;
+        double tUpdate = 0.0, tQuery = 0.0;
+        size_t nQueries = 0, nIndexed = 0;
+        for (size_t i = 0; i < descriptors.size(); ++i)
+        {
+            if (i >= windowSize)
+            {
+                vector<vector<cv::DMatch>> knnMatches;
+                double t = (double)cv::getTickCount();
+                index.knnMatch(descriptors[i], knnMatches, 2);
+                tQuery += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+                nQueries += descriptors[i].rows;
+                nIndexed += index.size();
+            }
+
+            double t = (double)cv::getTickCount();
+            windowIds.push_back(index.insert(descriptors[i]));
+            if (windowIds.size() > windowSize)
+            {
+                index.remove(windowIds.front());
+                windowIds.erase(windowIds.begin());
+            }
+            tUpdate += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+        }
+        double nSteps = (double)(descriptors.size() - windowSize);
+        cout << "LSH " << descriptorType << " sliding window of " << windowSize << " frames : " << nIndexed / nSteps << " indexed descriptors, insert/remove "
+             << 1000 * tUpdate / descriptors.size() << " ms/frame, query " << 1000 * tQuery / nSteps << " ms/frame ("
+             << nQueries / max(1e-9, tQuery) << " queries/s)" << endl;
+    }
+}
+
+// Compare cv::BFMatcher against the HNSW graph matcher (MAT_HNSW) for SIFT descriptors, then sweep the search list
+// size ef and report the recall of the nearest neighbour against brute force together with build and query times
+static void benchHnswMatcher(vector<cv::Mat> &imgsGray)
+{
+    vector<vector<cv::KeyPoint>> keypoints;
+    vector<cv::Mat> descriptors;
+    detectAndDescribeAll(imgsGray, "SIFT", keypoints, descriptors);
+    compareWithBFMatcher("HNSW SIFT", keypoints, descriptors, "DES_HOG", "MAT_HNSW");
+
+    vector<int> efValues = {8, 16, 32, 64, 128};
+    vector<double> tQuery(efValues.size(), 0.0);
+    vector<size_t> nFound(efValues.size(), 0);
+    double tBuild = 0.0;
+    size_t nQueries = 0;
+    cv::Ptr<cv::BFMatcher> bruteForce = cv::BFMatcher::create(cv::NORM_L2);
+    for (size_t i = 0; i + 1 < descriptors.size(); ++i)
+    {
+        vector<cv::DMatch> exact;
+        bruteForce->match(descriptors[i], descriptors[i + 1], exact);
+        nQueries += exact.size();
+
+        HnswIndex index(descriptors[i + 1].cols);
+        double t = (double)cv::getTickCount();
+        index.build(descriptors[i + 1]);
+        tBuild += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+
+        for (size_t e = 0; e < efValues.size(); ++e)
+        {
+            vector<vector<cv::DMatch>> knnMatches;
+            index.setEf(efValues[e]);
+            t = (double)cv::getTickCount();
+            index.knnMatch(descriptors[i], knnMatches, 2);
+            tQuery[e] += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+            for (auto &match : exact)
+            {
+                auto &found = knnMatches[match.queryIdx];
+                nFound[e] += (!found.empty() && found[0].trainIdx == match.trainIdx) ? 1 : 0;
+            }
+        }
+    }
+    double nPairs = (double)(descriptors.size() - 1);
+    cout << "HNSW SIFT build (M=16, efConstruction=100) " << 1000 * tBuild / nPairs << " ms/frame" << endl;
+    for (size_t e = 0; e < efValues.size(); ++e)
+    {
+        cout << "HNSW SIFT ef=" << efValues[e] << " : recall@1 " << 100.0 * nFound[e] / max<size_t>(1, nQueries) << "%, query "
+             << 1000 * tQuery[e] / nPairs << " ms/pair" << endl;
+    }
+}
+
+// Compare cv::BFMatcher with crossCheck, which matches both directions separately, against the single pass
+// mutual nearest neighbour selector (SEL_MUTUAL) for binary and SIFT descriptors
+static void benchMutualMatcher(vector<cv::Mat> &imgsGray)
+{
+    vector<string> featureTypes = {"ORB", "BRISK", "SIFT"};
+    for (auto &featureType : featureTypes)
+    {
+        vector<vector<cv::KeyPoint>> keypoints;
+        vector<cv::Mat> descriptors;
+        detectAndDescribeAll(imgsGray, featureType, keypoints, descriptors);
+        string descriptorType = featureType.compare("SIFT") == 0 ? "DES_HOG" : "DES_BINARY";
+        cv::Ptr<cv::BFMatcher> crossCheck = cv::BFMatcher::create(descriptorType.compare("DES_BINARY") == 0 ? cv::NORM_HAMMING : cv::NORM_L2, true);
+
+        double tRef = 0.0, tNew = 0.0;
+        size_t nRef = 0, nNew = 0, nAgree = 0;
+        for (size_t i = 0; i + 1 < descriptors.size(); ++i)
+        {
+            vector<cv::DMatch> matchesRef, matchesNew;
+            double t = (double)cv::getTickCount();
+            crossCheck->match(descriptors[i], descriptors[i + 1], matchesRef);
+            tRef += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+
+            t = (double)cv::getTickCount();
+            matchDescriptors(keypoints[i], keypoints[i + 1], descriptors[i], descriptors[i + 1], matchesNew, descriptorType, "MAT_BF", "SEL_MUTUAL");
+            tNew += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+
+            map<int, int> reference;
+            for (auto &match : matchesRef)
+            {
+                reference[match.queryIdx] = match.trainIdx;
+            }
+            for (auto &match : matchesNew)
+            {
+                auto it = reference.find(match.queryIdx);
+                nAgree += (it != reference.end() && it->second == match.trainIdx) ? 1 : 0;
+            }
+            nRef += matchesRef.size();
+            nNew += matchesNew.size();
+        }
+        double nPairs = (double)(descriptors.size() - 1);
+        cout << "MUTUAL " << featureType << " : BFMatcher crossCheck " << 1000 * tRef / nPairs << " ms/pair (" << nRef / nPairs << " matches), SEL_MUTUAL "
+             << 1000 * tNew / nPairs << " ms/pair (" << nNew / nPairs << " matches), speedup " << tRef / tNew << "x, agreement "
+             << 100.0 * nAgree / max<size_t>(1, nRef) << "%" << endl;
+    }
+}
+
+// Check that the track manager only pairs boxes across frames along the box associations : a box pair which the
+// association rejected must not be continued by the overlap-based reacquisition, so no TTC is computed for it
+static void benchTrackManager()
+{
+    auto makeFrame = [](cv::Rect roi) {
+        DataFrame frame;
+        BoundingBox box;
+        box.boxID = 0;
+        box.roi = roi;
+        box.classID = 2;
+        box.confidence = 1.0;
+        frame.boundingBoxes.push_back(box);
+        return frame;
+    };
+    auto countTtcPairs = [](TrackManager &manager) { // tracks observed in both frames, as in the TTC loop of the final project
+        int nPairs = 0;
+        for (auto &track : manager.tracks())
+        {
+            nPairs += track.prevBoxIdx >= 0 && track.currBoxIdx >= 0;
+        }
+        return nPairs;
+    };
+
+    // the same object in three frames, associated from frame 0 to 1 and rejected by the association from frame 1 to 2
+    vector<DataFrame> frames = {makeFrame(cv::Rect(100, 100, 50, 50)), makeFrame(cv::Rect(102, 100, 50, 50)), makeFrame(cv::Rect(104, 100, 50, 50))};
+    TrackManager manager(2, 20);
+    map<int, int> associated = {{0, 0}}, rejected;
+    manager.update(frames[0], frames[1], associated, 0, 2);
+    int nAssociated = countTtcPairs(manager);
+    manager.update(frames[1], frames[2], rejected, 2, 4);
+    int nRejected = countTtcPairs(manager);
+
+    cout << "TRACKS : " << nAssociated << " TTC pairs for an associated box pair, " << nRejected << " for a rejected one" << endl;
+    CV_Assert(nAssociated == 1 && nRejected == 0);
+    CV_Assert(frames[2].boundingBoxes[0].trackID != frames[1].boundingBoxes[0].trackID);
+}
+
+/* MAIN PROGRAM */
+int main(int argc, const char *argv[])
+{
+    // usage : benchmark_camera [benchmark] [pcaFile] where benchmark is one of HARRIS_NMS, TILED, FAST_SIMD, BRIEF_SIMD, QUANT_SIFT, HAMMING, GEMM, LSH, HNSW, MUTUAL, TRACKS or ALL (default)
+    // and pcaFile is where QUANT_SIFT writes the fitted SIFT PCA, e.g. ../dat/sift_pca64.yml (not written by default)
+    string benchmark = argc > 1 ? argv[1] : "ALL";
+    string pcaFile = argc > 2 ? argv[2] : "";
+
+    // data location
+    string dataPath = "../";
+    string imgBasePath = dataPath + "images/";
+    string imgPrefix = "KITTI/2011_09_26/image_02/data/000000"; // left camera, color
+    string imgFileType = ".png";
+    int imgStartIndex = 0; // first file index to load
+    int imgEndIndex = 18;  // last file index to load
+    int imgFillWidth = 4;  // no. of digits which make up the file index (e.g. img-0001.png)
+
+    // load all frames up front so that disk access does not pollute the timings
+    vector<cv::Mat> imgsColor, imgsGray;
+    for (int imgIndex = imgStartIndex; imgIndex <= imgEndIndex; imgIndex++)
+    {
+        ostringstream imgNumber;
+        imgNumber << setfill('0') << setw(imgFillWidth) << imgIndex;
+        cv::Mat img = cv::imread(imgBasePath + imgPrefix + imgNumber.str() + imgFileType);
+        if (img.empty())
+        {
+            cerr << "Could not load image " << imgNumber.str() << endl;
+            return 1;
+        }
+        cv::Mat imgGray;
+        cv::cvtColor(img, imgGray, cv::COLOR_BGR2GRAY);
+        imgsColor.push_back(img);
+        imgsGray.push_back(imgGray);
+    }
+
+    if (benchmark == "ALL" || benchmark == "HARRIS_NMS")
+    {
+        benchHarrisNms(imgsGray);
+    }
+    if (benchmark == "ALL" || benchmark == "TILED")
+    {
+        benchTiledDetection(imgsGray);
+    }
+    if (benchmark == "ALL" || benchmark == "FAST_SIMD")
+    {
+        benchFastSimd(imgsGray);
+    }
+    if (benchmark == "ALL" || benchmark == "BRIEF_SIMD")
+    {
+        benchBriefSimd(imgsGray);
+    }
+    if (benchmark == "ALL" || benchmark == "QUANT_SIFT")
+    {
+        benchQuantizedSift(imgsGray, pcaFile);
+    }
+    if (benchmark == "ALL" || benchmark == "HAMMING")
+    {
+        benchHammingMatcher(imgsGray);
+    }
+    if (benchmark == "ALL" || benchmark == "GEMM")
+    {
+        benchGemmMatcher(imgsGray);
+    }
+    if (benchmark == "ALL" || benchmark == "LSH")
+    {
+        benchLshMatcher(imgsGray);
+    }
+    if (benchmark == "ALL" || benchmark == "HNSW")
+    {
+        benchHnswMatcher(imgsGray);
+    }
+    if (benchmark == "ALL" || benchmark == "MUTUAL")
+    {
+        benchMutualMatcher(imgsGray);
+    }
+    if (benchmark == "ALL" || benchmark == "TRACKS")
+    {
+        benchTrackManager();
+    }
+
+    return 0;
+}
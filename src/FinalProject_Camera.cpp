@@ -19,6 +19,7 @@
 #include "objectDetection2D.hpp"
 #include "lidarData.hpp"
 #include "camFusion.hpp"
+#include "trackManager.hpp"
 
 using namespace std;
 
@@ -77,6 +78,50 @@ int main(int argc, const char *argv[])
     vector<DataFrame> dataBuffer; // list of data frames which are held in memory at the same time
     bool bVis = false;            // visualize results
 
+    // optional : FAST_SIMD threshold per image region, one CV_8U cell per region of a grid laid over the image,
+    // e.g. (cv::Mat_<uchar>(2, 1) << 40, 20) for fewer keypoints in the sky than on the road; empty for one threshold
+    cv::Mat fastThresholdGrid;
+
+    // optional : adapt the detector threshold from frame to frame to keep the keypoint count near a target
+    bool bKeypointBudget = false;
+    KeypointBudget keypointBudget(500); // target no. of keypoints per frame
+
+    // optional : track keypoints from frame to frame with pyramidal Lucas-Kanade instead of detecting, describing
+    // and matching them in every frame; keypoints are replenished by the detector when too few tracks survive
+    bool bTrackKLT = false;
+    KltTracking kltTracking(300, 10); // min. no. of tracks, replenishment interval in frames
+
+    // optional : store SIFT descriptors as uint8 (optionally as RootSIFT and PCA-reduced) and match them with an
+    // integer L2 kernel; a PCA can be fitted on the KITTI frames with ./benchmark_camera QUANT_SIFT ../dat/sift_pca64.yml
+    bool bQuantizeSift = false;
+    SiftQuantizer siftQuantizer(false); // true for RootSIFT
+    string siftPcaFile = "";            // e.g. "../dat/sift_pca64.yml", empty for all 128 dimensions
+    // optional : only match keypoints within a search window around their predicted position in the current frame
+    bool bMatchWindowed = false;
+    float matchSearchRadius = 40.f; // search radius in pixels
+    bool bPredictBoxFlow = true;    // predict with the last median flow of the enclosing bounding box, else zero motion
+
+    // optional : only match keypoints of previous boxes against keypoints of the current boxes overlapping their
+    // predicted position, as only matches inside bounding boxes contribute to TTC
+    bool bMatchBoxPairs = false;
+
+    // optional : with MAT_FLANN, build the index over each frame's descriptors once and query it with the next frame
+    bool bPersistentIndex = false;
+
+    // optional : associate bounding boxes one-to-one by solving the assignment problem over keypoint votes and IoU,
+    // instead of picking the current box with the most votes for every previous box independently
+    bool bAssignBoxesOptimal = false;
+    int boxMinVotes = 3;       // gating : min. no. of keypoint matches between two associated boxes
+    double boxMinIoU = 0.1;    // gating : min. intersection over union of two associated boxes
+
+    // object tracks across frames, continued from the box associations; TTC is computed per track
+    TrackManager trackManager(2, 20); // max. no. of consecutive missed frames, TTC history length
+
+    if (bQuantizeSift && !siftPcaFile.empty())
+    {
+        loadSiftPca(siftQuantizer, siftPcaFile);
+    }
+
     /* MAIN LOOP OVER ALL IMAGES */
 
     for (size_t imgIndex = 0; imgIndex <= imgEndIndex - imgStartIndex; imgIndex+=imgStepWidth)
@@ -95,6 +140,10 @@ int main(int argc, const char *argv[])
         DataFrame frame;
         frame.cameraImg = img;
         dataBuffer.push_back(frame);
+        if (dataBuffer.size() > 2)
+        { // only the previous and the current frame are tracked with their pyramids
+            (dataBuffer.end() - 3)->pyramid = ImagePyramid();
+        }
 
         cout << "#1 : LOAD IMAGE INTO BUFFER done" << endl;
 
@@ -120,7 +169,7 @@ int main(int argc, const char *argv[])
         float minZ = -1.5, maxZ = -0.9, minX = 2.0, maxX = 20.0, maxY = 2.0, minR = 0.1; // focus on ego lane
         cropLidarPoints(lidarPoints, minX, maxX, maxY, minZ, maxZ, minR);
     
-        (dataBuffer.end() - 1)->lidarPoints = lidarPoints;
+        (dataBuffer.end() - 1)->lidarPoints = std::move(lidarPoints); // bounding boxes reference these points by index
 
         cout << "#3 : CROP LIDAR POINTS done" << endl;
 
@@ -135,7 +184,7 @@ int main(int argc, const char *argv[])
         bVis = false;
         if(bVis)
         {
-            show3DObjects((dataBuffer.end()-1)->boundingBoxes, cv::Size(4.0, 20.0), cv::Size(2000, 2000), true);
+            show3DObjects((dataBuffer.end()-1)->boundingBoxes, (dataBuffer.end()-1)->lidarPoints, cv::Size(4.0, 20.0), cv::Size(2000, 2000), true);
         }
         bVis = false;
 
@@ -147,15 +196,61 @@ int main(int argc, const char *argv[])
 
         /* DETECT IMAGE KEYPOINTS */
 
-        // convert current image to grayscale
-        cv::Mat imgGray;
-        cv::cvtColor((dataBuffer.end()-1)->cameraImg, imgGray, cv::COLOR_BGR2GRAY);
+        // grayscale view of the current image, converted once and shared by all detectors and extractors
+        cv::Mat imgGray = getGrayImage(*(dataBuffer.end() - 1));
 
         // extract 2D keypoints from current image
         vector<cv::KeyPoint> keypoints; // create empty feature list for current image
-        string detectorType = "SIFT"; // SHITOMASI, HARRIS, FAST, BRISK, ORB, AKAZE, SIFT
+        string detectorType = "SIFT"; // SHITOMASI, HARRIS, FAST, FAST_SIMD, BRISK, ORB, AKAZE, SIFT
+        string descriptorType = "SIFT"; // BRISK, BRIEF, BRIEF_SIMD, ORB, FREAK, AKAZE, SIFT
+        cv::Mat descriptors;
+        bool bLimitKpts = false; // limit number of keypoints (see below)
+
+        // optional : only detect and describe keypoints inside the (padded) object bounding boxes,
+        // as keypoints outside of them are never used for box matching or TTC computation
+        bool bDetectInRois = false;
+        int roiPadding = 20; // padding around each bounding box in pixels
+        vector<cv::Rect> detectionRois;
+
+        // optional : split the image into overlapping tiles which are processed in parallel
+        bool bDetectTiled = false;
+        int tilesX = 4, tilesY = 2; // number of tiles along image columns and rows
+        int tileOverlap = 16;       // context around each tile in pixels
+        int maxTiledKeypoints = 0;  // cap on the merged keypoints by response (0 = no cap)
+
+        // optional : compute descriptors for horizontal strips of keypoints in parallel (AKAZE and SIFT stay serial)
+        bool bDescribeParallel = false;
+
+        // detector and descriptor of the same kind (e.g. SIFT/SIFT) share scale space and orientation
+        // in a single detect-and-compute pass, unless keypoints are altered in between
+        bool bTrackFrame = bTrackKLT && dataBuffer.size() > 1; // the first frame has nothing to track from
+        vector<cv::DMatch> kltMatches;
 
-        if (detectorType.compare("SHITOMASI") == 0)
+        bool bFusedFeatures = !bTrackKLT && !bDetectInRois && !bDetectTiled && !bKeypointBudget && !bLimitKpts && isFusedFeatureType(detectorType, descriptorType);
+
+        if (bTrackFrame)
+        {
+            trackKeypointsKLT((dataBuffer.end() - 2)->keypoints, (dataBuffer.end() - 2)->pyramid, keypoints, (dataBuffer.end() - 1)->pyramid,
+                              kltMatches, detectorType, kltTracking);
+        }
+        else if (bFusedFeatures)
+        {
+            detectAndDescribe(keypoints, imgGray, descriptors, detectorType);
+        }
+        else if (bDetectInRois)
+        {
+            detectionRois = computeDetectionRois((dataBuffer.end() - 1)->boundingBoxes, imgGray.size(), roiPadding);
+            detKeypointsInRois(keypoints, imgGray, detectionRois, detectorType);
+        }
+        else if (bDetectTiled)
+        {
+            detKeypointsTiled(keypoints, imgGray, detectorType, tilesX, tilesY, tileOverlap, maxTiledKeypoints);
+        }
+        else if (bKeypointBudget)
+        {
+            detKeypointsBudget(keypoints, imgGray, detectorType, keypointBudget, false);
+        }
+        else if (detectorType.compare("SHITOMASI") == 0)
         {
             detKeypointsShiTomasi(keypoints, imgGray, false);
         }
@@ -165,12 +260,12 @@ int main(int argc, const char *argv[])
         }
         else
         {
-            detKeypointsModern(keypoints, imgGray, detectorType, false);
+            detKeypointsModern(keypoints, imgGray, detectorType, false, detectorType.compare("FAST_SIMD") == 0 ? fastThresholdGrid : cv::Mat());
         }
 
-        // optional : limit number of keypoints (helpful for debugging and learning)
-        bool bLimitKpts = false;
-        if (bLimitKpts)
+        // optional : limit number of keypoints (helpful for debugging and learning), not for tracked keypoints
+        // as their order is referenced by the tracking matches
+        if (bLimitKpts && !bTrackFrame)
         {
             int maxKeypoints = 50;
 
@@ -190,9 +285,31 @@ int main(int argc, const char *argv[])
 
         /* EXTRACT KEYPOINT DESCRIPTORS */
 
-        cv::Mat descriptors;
-        string descriptorType = "SIFT"; // BRISK, BRIEF, ORB, FREAK, AKAZE, SIFT
-        descKeypoints((dataBuffer.end() - 1)->keypoints, (dataBuffer.end() - 1)->cameraImg, descriptors, descriptorType);
+        if (bFusedFeatures)
+        {
+            // descriptors have been computed together with the keypoints
+        }
+        else if (bTrackKLT)
+        {
+            // tracked keypoints need no descriptors
+        }
+        else if (bDetectInRois)
+        {
+            descKeypointsInRois((dataBuffer.end() - 1)->keypoints, imgGray, descriptors, detectionRois, descriptorType);
+        }
+        else if (bDescribeParallel)
+        {
+            descKeypointsParallel((dataBuffer.end() - 1)->keypoints, imgGray, descriptors, descriptorType);
+        }
+        else
+        {
+            descKeypoints((dataBuffer.end() - 1)->keypoints, imgGray, descriptors, descriptorType);
+        }
+
+        if (bQuantizeSift)
+        {
+            quantizeSiftDescriptors(descriptors, siftQuantizer);
+        }
 
         // push descriptors for current frame to end of data buffer
         (dataBuffer.end() - 1)->descriptors = descriptors;
@@ -206,13 +323,50 @@ int main(int argc, const char *argv[])
             /* MATCH KEYPOINT DESCRIPTORS */
 
             vector<cv::DMatch> matches;
-            string matcherType = "MAT_BF";        // MAT_BF, MAT_FLANN
-            string descriptorType = "DES_HOG"; // DES_BINARY, DES_HOG
-            string selectorType = "SEL_KNN";       // SEL_NN, SEL_KNN
+            string matcherType = "MAT_BF";        // MAT_BF, MAT_FLANN, MAT_HAMMING, MAT_LSH (binary descriptors only), MAT_GEMM, MAT_HNSW (DES_HOG only)
+            string descriptorType = bQuantizeSift ? "DES_HOG_U8" : "DES_HOG"; // DES_BINARY, DES_HOG, DES_HOG_U8
+            string selectorType = "SEL_KNN";       // SEL_NN, SEL_KNN, SEL_MUTUAL, SEL_MUTUAL_KNN (mutual : MAT_BF, MAT_HAMMING, MAT_GEMM only)
 
-            matchDescriptors((dataBuffer.end() - 2)->keypoints, (dataBuffer.end() - 1)->keypoints,
-                             (dataBuffer.end() - 2)->descriptors, (dataBuffer.end() - 1)->descriptors,
-                             matches, descriptorType, matcherType, selectorType);
+            if (bTrackKLT)
+            {
+                matches = kltMatches; // tracks already link the keypoints of both frames
+            }
+            else if (bPersistentIndex && matcherType.compare("MAT_FLANN") == 0)
+            {
+                if ((dataBuffer.end() - 2)->descriptorIndex.empty())
+                {
+                    buildDescriptorIndex(*(dataBuffer.end() - 2), descriptorType); // first frame pair
+                }
+                matchDescriptorsWithIndex(*(dataBuffer.end() - 2), (dataBuffer.end() - 1)->descriptors, matches, descriptorType, selectorType);
+                (dataBuffer.end() - 2)->descriptorIndex.release(); // each index is queried exactly once
+
+                // index the current frame, which is the train set of the next frame pair
+                buildDescriptorIndex(*(dataBuffer.end() - 1), descriptorType);
+            }
+            else if (bMatchBoxPairs)
+            {
+                vector<BoundingBox> noBoxes; // the first frame pair has no box tracks yet
+                vector<BoundingBox> &boxesPrevPrev = dataBuffer.size() > 2 ? (dataBuffer.end() - 3)->boundingBoxes : noBoxes;
+                matchDescriptorsInBoxPairs(boxesPrevPrev, *(dataBuffer.end() - 2), *(dataBuffer.end() - 1), matches,
+                                           descriptorType, matcherType, selectorType);
+            }
+            else if (bMatchWindowed)
+            {
+                vector<cv::Point2f> flow; // empty for zero motion
+                if (bPredictBoxFlow && dataBuffer.size() > 2)
+                {
+                    predictKeypointFlow((dataBuffer.end() - 3)->keypoints, *(dataBuffer.end() - 2), flow);
+                }
+                matchDescriptorsWindowed((dataBuffer.end() - 2)->keypoints, (dataBuffer.end() - 1)->keypoints,
+                                         (dataBuffer.end() - 2)->descriptors, (dataBuffer.end() - 1)->descriptors,
+                                         matches, descriptorType, selectorType, matchSearchRadius, flow);
+            }
+            else
+            {
+                matchDescriptors((dataBuffer.end() - 2)->keypoints, (dataBuffer.end() - 1)->keypoints,
+                                 (dataBuffer.end() - 2)->descriptors, (dataBuffer.end() - 1)->descriptors,
+                                 matches, descriptorType, matcherType, selectorType);
+            }
 
             // store matches in current data frame
             (dataBuffer.end() - 1)->kptMatches = matches;
@@ -225,7 +379,14 @@ int main(int argc, const char *argv[])
             //// STUDENT ASSIGNMENT
             //// TASK FP.1 -> match list of 3D objects (vector<BoundingBox>) between current and previous frame (implement ->matchBoundingBoxes)
             map<int, int> bbBestMatches;
-            matchBoundingBoxes(matches, bbBestMatches, *(dataBuffer.end()-2), *(dataBuffer.end()-1)); // associate bounding boxes between current and previous frame using keypoint matches
+            if (bAssignBoxesOptimal)
+            {
+                matchBoundingBoxesOptimal(matches, bbBestMatches, *(dataBuffer.end()-2), *(dataBuffer.end()-1), boxMinVotes, boxMinIoU);
+            }
+            else
+            {
+                matchBoundingBoxes(matches, bbBestMatches, *(dataBuffer.end()-2), *(dataBuffer.end()-1)); // associate bounding boxes between current and previous frame using keypoint matches
+            }
             //// EOF STUDENT ASSIGNMENT
 
             // store matches in current data frame
@@ -236,34 +397,28 @@ int main(int argc, const char *argv[])
 
             /* COMPUTE TTC ON OBJECT IN FRONT */
 
-            // loop over all BB match pairs
-            for (auto it1 = (dataBuffer.end() - 1)->bbMatches.begin(); it1 != (dataBuffer.end() - 1)->bbMatches.end(); ++it1)
-            {
-                // find bounding boxes associates with current match
-                BoundingBox *prevBB, *currBB;
-                for (auto it2 = (dataBuffer.end() - 1)->boundingBoxes.begin(); it2 != (dataBuffer.end() - 1)->boundingBoxes.end(); ++it2)
-                {
-                    if (it1->second == it2->boxID) // check wether current match partner corresponds to this BB
-                    {
-                        currBB = &(*it2);
-                    }
-                }
+            // continue the object tracks, which also assigns BoundingBox::trackID in the current frame
+            trackManager.update(*(dataBuffer.end()-2), *(dataBuffer.end()-1), (dataBuffer.end()-1)->bbMatches,
+                                (int)(imgIndex - imgStepWidth), (int)imgIndex);
 
-                for (auto it2 = (dataBuffer.end() - 2)->boundingBoxes.begin(); it2 != (dataBuffer.end() - 2)->boundingBoxes.end(); ++it2)
+            // loop over all tracks observed in both frames
+            for (auto &track : trackManager.tracks())
+            {
+                if (track.prevBoxIdx < 0 || track.currBoxIdx < 0)
                 {
-                    if (it1->first == it2->boxID) // check wether current match partner corresponds to this BB
-                    {
-                        prevBB = &(*it2);
-                    }
+                    continue;
                 }
+                BoundingBox *prevBB = &(dataBuffer.end() - 2)->boundingBoxes[track.prevBoxIdx];
+                BoundingBox *currBB = &(dataBuffer.end() - 1)->boundingBoxes[track.currBoxIdx];
 
                 // compute TTC for current match
-                if( currBB->lidarPoints.size()>0 && prevBB->lidarPoints.size()>0 ) // only compute TTC if we have Lidar points
+                if( currBB->lidarPointIndices.size()>0 && prevBB->lidarPointIndices.size()>0 ) // only compute TTC if we have Lidar points
                 {
                     //// STUDENT ASSIGNMENT
                     //// TASK FP.2 -> compute time-to-collision based on Lidar data (implement -> computeTTCLidar)
                     double ttcLidar; 
-                    computeTTCLidar(prevBB->lidarPoints, currBB->lidarPoints, sensorFrameRate, ttcLidar);
+                    computeTTCLidar((dataBuffer.end() - 2)->lidarPoints, prevBB->lidarPointIndices,
+                                    (dataBuffer.end() - 1)->lidarPoints, currBB->lidarPointIndices, sensorFrameRate, ttcLidar);
                     //// EOF STUDENT ASSIGNMENT
 
                     //// STUDENT ASSIGNMENT
@@ -274,12 +429,18 @@ int main(int argc, const char *argv[])
                     double ttcCamera;
                     computeTTCCamera((dataBuffer.end() - 2)->keypoints, (dataBuffer.end() - 1)->keypoints, currBB->kptMatches, sensorFrameRate, ttcCamera);
                     //// EOF STUDENT ASSIGNMENT 
+                    trackManager.addTtc(track.trackID, ttcLidar, ttcCamera);
 
                     bVis = true;
                     if (bVis)
                     {
                         cv::Mat visImg = (dataBuffer.end() - 1)->cameraImg.clone();
-                        showLidarImgOverlay(visImg, currBB->lidarPoints, P_rect_00, R_rect_00, RT, &visImg);
+                        vector<LidarPoint> bbLidarPoints; // gather the points of the current box for the overlay
+                        for (uint32_t idx : currBB->lidarPointIndices)
+                        {
+                            bbLidarPoints.push_back((dataBuffer.end() - 1)->lidarPoints[idx]);
+                        }
+                        showLidarImgOverlay(visImg, bbLidarPoints, P_rect_00, R_rect_00, RT, &visImg);
                         cv::rectangle(visImg, cv::Point(currBB->roi.x, currBB->roi.y), cv::Point(currBB->roi.x + currBB->roi.width, currBB->roi.y + currBB->roi.height), cv::Scalar(0, 255, 0), 2);
                         
                         char str[200];
@@ -295,11 +456,13 @@ int main(int argc, const char *argv[])
                     bVis = false;
 
                 } // eof TTC computation
-            } // eof loop over all BB matches            
+            } // eof loop over all tracks            
 
         }
 
     } // eof loop over all images
 
+    cout << "Feature engine construction (once per run) in " << 1000 * getEngineConstructionTime() << " ms" << endl;
+
     return 0;
 }
\ No newline at end of file
@@ -28,14 +28,17 @@
 
 void clusterLidarWithROI(std::vector<BoundingBox> &boundingBoxes, std::vector<LidarPoint> &lidarPoints, float shrinkFactor, cv::Mat &P_rect_xx, cv::Mat &R_rect_xx, cv::Mat &RT);
 void clusterKptMatchesWithROI(BoundingBox &boundingBox, std::vector<cv::KeyPoint> &kptsPrev, std::vector<cv::KeyPoint> &kptsCurr, std::vector<cv::DMatch> &kptMatches);
+cv::Mat boxVoteMatrix(std::vector<cv::DMatch> &matches, DataFrame &prevFrame, DataFrame &currFrame);
 void matchBoundingBoxes(std::vector<cv::DMatch> &matches, std::map<int, int> &bbBestMatches, DataFrame &prevFrame, DataFrame &currFrame);
+double matchBoundingBoxesOptimal(std::vector<cv::DMatch> &matches, std::map<int, int> &bbBestMatches, DataFrame &prevFrame, DataFrame &currFrame,
+                                 int minVotes=3, double minIoU=0.1);
 
-void show3DObjects(std::vector<BoundingBox> &boundingBoxes, cv::Size worldSize, cv::Size imageSize, bool bWait=true);
+void show3DObjects(std::vector<BoundingBox> &boundingBoxes, std::vector<LidarPoint> &lidarPoints, cv::Size worldSize, cv::Size imageSize, bool bWait=true);
 
 void computeTTCCamera(std::vector<cv::KeyPoint> &kptsPrev, std::vector<cv::KeyPoint> &kptsCurr,
                       std::vector<cv::DMatch> kptMatches, double frameRate, double &TTC, cv::Mat *visImg=nullptr);
-void computeTTCLidar(std::vector<LidarPoint> &lidarPointsPrev,
-                     std::vector<LidarPoint> &lidarPointsCurr, double frameRate, double &TTC);      
+void computeTTCLidar(std::vector<LidarPoint> &lidarPointsPrev, std::vector<uint32_t> &indicesPrev,
+                     std::vector<LidarPoint> &lidarPointsCurr, std::vector<uint32_t> &indicesCurr, double frameRate, double &TTC);
 
-pcl::PointCloud<pcl::PointXYZ>::Ptr clustering(std::vector<LidarPoint> &lidarPoints, float clusterTolerance, int minSize, int maxSize);                              
+std::vector<uint32_t> clustering(std::vector<LidarPoint> &lidarPoints, std::vector<uint32_t> &indices, float clusterTolerance, int minSize, int maxSize);
 #endif /* camFusion_hpp */
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <algorithm>
 #include <numeric>
+#include <limits>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
@@ -18,6 +19,8 @@ void clusterLidarWithROI(std::vector<BoundingBox> &boundingBoxes, std::vector<Li
 
     for (auto it1 = lidarPoints.begin(); it1 != lidarPoints.end(); ++it1)
     {
+        uint32_t ptIdx = (uint32_t)(it1 - lidarPoints.begin()); // position of the current point within the frame's Lidar points
+
         // assemble vector for matrix-vector-multiplication
         X.at<double>(0, 0) = it1->x;
         X.at<double>(1, 0) = it1->y;
@@ -51,15 +54,15 @@ void clusterLidarWithROI(std::vector<BoundingBox> &boundingBoxes, std::vector<Li
         // check wether point has been enclosed by one or by multiple boxes
         if (enclosingBoxes.size() == 1)
         { 
-            // add Lidar point to bounding box
-            enclosingBoxes[0]->lidarPoints.push_back(*it1);
+            // add index of Lidar point to bounding box
+            enclosingBoxes[0]->lidarPointIndices.push_back(ptIdx);
         }
 
     } // eof loop over all Lidar points
 }
 
 
-void show3DObjects(std::vector<BoundingBox> &boundingBoxes, cv::Size worldSize, cv::Size imageSize, bool bWait)
+void show3DObjects(std::vector<BoundingBox> &boundingBoxes, std::vector<LidarPoint> &lidarPoints, cv::Size worldSize, cv::Size imageSize, bool bWait)
 {
     // create topview image
     cv::Mat topviewImg(imageSize, CV_8UC3, cv::Scalar(255, 255, 255));
@@ -73,11 +76,12 @@ void show3DObjects(std::vector<BoundingBox> &boundingBoxes, cv::Size worldSize,
         // plot Lidar points into top view image
         int top=1e8, left=1e8, bottom=0.0, right=0.0; 
         float xwmin=1e8, ywmin=1e8, ywmax=-1e8;
-        for (auto it2 = it1->lidarPoints.begin(); it2 != it1->lidarPoints.end(); ++it2)
+        for (auto it2 = it1->lidarPointIndices.begin(); it2 != it1->lidarPointIndices.end(); ++it2)
         {
             // world coordinates
-            float xw = (*it2).x; // world position in m with x facing forward from sensor
-            float yw = (*it2).y; // world position in m with y facing left from sensor
+            const LidarPoint &lidarPt = lidarPoints[*it2];
+            float xw = lidarPt.x; // world position in m with x facing forward from sensor
+            float yw = lidarPt.y; // world position in m with y facing left from sensor
             xwmin = xwmin<xw ? xwmin : xw;
             ywmin = ywmin<yw ? ywmin : yw;
             ywmax = ywmax>yw ? ywmax : yw;
@@ -101,7 +105,7 @@ void show3DObjects(std::vector<BoundingBox> &boundingBoxes, cv::Size worldSize,
 
         // augment object with some key data
         char str1[200], str2[200];
-        sprintf(str1, "id=%d, #pts=%d", it1->boxID, (int)it1->lidarPoints.size());
+        sprintf(str1, "id=%d, #pts=%d", it1->boxID, (int)it1->lidarPointIndices.size());
         putText(topviewImg, str1, cv::Point2f(left-250, bottom+50), cv::FONT_ITALIC, 2, currColor);
         sprintf(str2, "xmin=%2.2f m, yw=%2.2f m", xwmin, ywmax-ywmin);
         putText(topviewImg, str2, cv::Point2f(left-250, bottom+125), cv::FONT_ITALIC, 2, currColor);  
@@ -227,12 +231,15 @@ void computeTTCCamera(std::vector<cv::KeyPoint> &kptsPrev, std::vector<cv::KeyPo
     }
 }
 
-pcl::PointCloud<pcl::PointXYZ>::Ptr clustering(std::vector<LidarPoint> &lidarPoints, float clusterTolerance, int minSize, int maxSize)
+// Apply euclidean clustering to the Lidar points referenced by indices and return the frame indices of all clustered (inlier) points
+std::vector<uint32_t> clustering(std::vector<LidarPoint> &lidarPoints, std::vector<uint32_t> &indices, float clusterTolerance, int minSize, int maxSize)
 {
 
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new typename pcl::PointCloud<pcl::PointXYZ>);
-    for (const auto &p : lidarPoints)
+    cloud->reserve(indices.size());
+    for (uint32_t idx : indices)
     {
+        const LidarPoint &p = lidarPoints[idx];
         cloud->push_back(pcl::PointXYZ((float)p.x, (float)p.y, (float)p.z));
     }
 
@@ -250,26 +257,21 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr clustering(std::vector<LidarPoint> &lidarPoi
     ec.setInputCloud(cloud);
     ec.extract(clusterIndices);
 
-    if (clusterIndices.empty())
-    {
-        return pcl::PointCloud<pcl::PointXYZ>::Ptr(new pcl::PointCloud<pcl::PointXYZ>);
-    }
-
-    pcl::PointCloud<pcl::PointXYZ>::Ptr clusters(new pcl::PointCloud<pcl::PointXYZ>);
-
-    for(const pcl::PointIndices getIndices : clusterIndices)
+    // map cluster members back from the temporary cloud to the frame's Lidar points
+    std::vector<uint32_t> clusters;
+    for (const pcl::PointIndices &getIndices : clusterIndices)
     {
-        for (size_t index : getIndices.indices)
+        for (int index : getIndices.indices)
         {
-            clusters->points.push_back(cloud->points[index]);
+            clusters.push_back(indices[index]);
         }
-     }
+    }
 
    return clusters;
 }
 
-void computeTTCLidar(std::vector<LidarPoint> &lidarPointsPrev,
-                     std::vector<LidarPoint> &lidarPointsCurr, double frameRate, double &TTC)
+void computeTTCLidar(std::vector<LidarPoint> &lidarPointsPrev, std::vector<uint32_t> &indicesPrev,
+                     std::vector<LidarPoint> &lidarPointsCurr, std::vector<uint32_t> &indicesCurr, double frameRate, double &TTC)
 {
     double dt = 1.0/frameRate; // time between two measurements in seconds
     double laneWidht = 4.0; // ego lane assumed width
@@ -280,20 +282,22 @@ void computeTTCLidar(std::vector<LidarPoint> &lidarPointsPrev,
     double minXCurr = 1e9;
 
     // apply euclidean clustering to remove outliers
-    auto clusterPrevPts = clustering(lidarPointsPrev, clusterTolerance, 30, 25000);
-    auto clusterCurrPts = clustering(lidarPointsCurr, clusterTolerance, 30, 25000);
+    auto clusterPrevIdx = clustering(lidarPointsPrev, indicesPrev, clusterTolerance, 30, 25000);
+    auto clusterCurrIdx = clustering(lidarPointsCurr, indicesCurr, clusterTolerance, 30, 25000);
 
     // find closest distance to lidar points within ego lane
-    for (auto &lidarPt : clusterPrevPts->points)
+    for (uint32_t idx : clusterPrevIdx)
     {
+        const LidarPoint &lidarPt = lidarPointsPrev[idx];
         if (fabs(lidarPt.y) < laneWidht/2.0)
         {
             minXPrev = minXPrev > lidarPt.x ? lidarPt.x : minXPrev;
         }
     }
 
-    for (auto &lidarPt : clusterCurrPts->points)
+    for (uint32_t idx : clusterCurrIdx)
     {
+        const LidarPoint &lidarPt = lidarPointsCurr[idx];
         if (fabs(lidarPt.y) < laneWidht/2.0)
         {
             minXCurr = minXCurr > lidarPt.x ? lidarPt.x : minXCurr;
@@ -310,7 +314,29 @@ void computeTTCLidar(std::vector<LidarPoint> &lidarPointsPrev,
     }
 }
 
-void matchBoundingBoxes(std::vector<cv::DMatch> &matches, std::map<int, int> &bbBestMatches, DataFrame &prevFrame, DataFrame &currFrame)
+// Indices of the bounding boxes containing each keypoint, stored as boxIdx[boxStart[k]] .. boxIdx[boxStart[k + 1] - 1]
+// for keypoint k; a keypoint inside overlapping boxes belongs to all of them
+static void keypointBoxMembership(const std::vector<cv::KeyPoint> &keypoints, const std::vector<BoundingBox> &boundingBoxes,
+                                  std::vector<int> &boxStart, std::vector<int> &boxIdx)
+{
+    boxStart.assign(keypoints.size() + 1, 0);
+    boxIdx.clear();
+    for (size_t k = 0; k < keypoints.size(); ++k)
+    {
+        for (size_t b = 0; b < boundingBoxes.size(); ++b)
+        {
+            if (boundingBoxes[b].roi.contains(keypoints[k].pt))
+            {
+                boxIdx.push_back((int)b);
+            }
+        }
+        boxStart[k + 1] = (int)boxIdx.size();
+    }
+}
+
+// Count the keypoint matches connecting each pair of boxes : entry (p, c) of the CV_32S matrix is the number of
+// matches from a keypoint in prevFrame.boundingBoxes[p] to a keypoint in currFrame.boundingBoxes[c]
+cv::Mat boxVoteMatrix(std::vector<cv::DMatch> &matches, DataFrame &prevFrame, DataFrame &currFrame)
 {
     /* NOTE: After calling a cv::DescriptorMatcher::match function, 
     each DMatch contains two keypoint indices, queryIdx and trainIdx, based on the order of image arguments to match.
@@ -318,41 +344,174 @@ void matchBoundingBoxes(std::vector<cv::DMatch> &matches, std::map<int, int> &bb
     prevFrame.keypoints is indexed by queryIdx
     currFrame.keypoints is indexed by trainIdx */
 
-    for (const auto &prevBox : prevFrame.boundingBoxes)
+    vector<int> prevStart, prevIdx, currStart, currIdx;
+    keypointBoxMembership(prevFrame.keypoints, prevFrame.boundingBoxes, prevStart, prevIdx);
+    keypointBoxMembership(currFrame.keypoints, currFrame.boundingBoxes, currStart, currIdx);
+
+    cv::Mat votes = cv::Mat::zeros((int)prevFrame.boundingBoxes.size(), (int)currFrame.boundingBoxes.size(), CV_32S);
+    for (const auto &match : matches)
     {
-        std::map<int, int> m;
-        for (const auto &currBox : currFrame.boundingBoxes)
+        for (int i = prevStart[match.queryIdx]; i < prevStart[match.queryIdx + 1]; ++i)
         {
-            for (const auto &match : matches)
+            int *row = votes.ptr<int>(prevIdx[i]);
+            for (int j = currStart[match.trainIdx]; j < currStart[match.trainIdx + 1]; ++j)
             {
-                const auto &prevKeyPoint = prevFrame.keypoints[match.queryIdx].pt;
-                if (prevBox.roi.contains(prevKeyPoint))
+                row[currIdx[j]]++;
+            }
+        }
+    }
+    return votes;
+}
+
+// Associate every previous box with the current box sharing the most keypoint matches. Previous boxes without
+// any vote (no match ends in a current box) get no partner and are left out of bbBestMatches.
+void matchBoundingBoxes(std::vector<cv::DMatch> &matches, std::map<int, int> &bbBestMatches, DataFrame &prevFrame, DataFrame &currFrame)
+{
+    cv::Mat votes = boxVoteMatrix(matches, prevFrame, currFrame);
+    for (int p = 0; p < votes.rows; ++p)
+    {
+        const int *row = votes.ptr<int>(p);
+        int bestIdx = -1, bestVotes = 0;
+        for (int c = 0; c < votes.cols; ++c)
+        {
+            if (row[c] > bestVotes)
+            {
+                bestVotes = row[c];
+                bestIdx = c;
+            }
+        }
+        if (bestIdx < 0)
+        {
+            continue;
+        }
+        bbBestMatches[prevFrame.boundingBoxes[p].boxID] = currFrame.boundingBoxes[bestIdx].boxID;
+
+        bool bPrint = false;
+        if (bPrint)
+        {
+            std::cout << "ID Matching: " << prevFrame.boundingBoxes[p].boxID << " => " << currFrame.boundingBoxes[bestIdx].boxID
+                      << " (" << bestVotes << " votes)\n";
+        }
+    }
+}
+
+// Minimum cost assignment of the rows of a square n x n cost matrix (row-major) to its columns with the Hungarian
+// method in its shortest augmenting path form, O(n^3) with row potentials u and column potentials v;
+// assignment[r] is the column of row r
+static void solveAssignment(const std::vector<double> &cost, int n, std::vector<int> &assignment)
+{
+    const double inf = std::numeric_limits<double>::max();
+    vector<double> u(n + 1, 0.0), v(n + 1, 0.0), minv(n + 1);
+    vector<int> colRow(n + 1, 0), way(n + 1, 0); // 1-based row assigned to each column, 0 for none
+    vector<char> used(n + 1);
+    for (int r = 1; r <= n; ++r)
+    {
+        colRow[0] = r;
+        int c0 = 0;
+        fill(minv.begin(), minv.end(), inf);
+        fill(used.begin(), used.end(), 0);
+        do
+        {
+            used[c0] = 1;
+            int r0 = colRow[c0], c1 = 0;
+            double delta = inf;
+            for (int c = 1; c <= n; ++c)
+            {
+                if (!used[c])
                 {
-                    const auto &currKeyPoint = currFrame.keypoints[match.trainIdx].pt;
-                    if (currBox.roi.contains(currKeyPoint))
+                    double reduced = cost[(size_t)(r0 - 1) * n + (c - 1)] - u[r0] - v[c];
+                    if (reduced < minv[c])
+                    {
+                        minv[c] = reduced;
+                        way[c] = c0;
+                    }
+                    if (minv[c] < delta)
                     {
-                        if (m.count(currBox.boxID) == 0)
-                        {
-                            m[currBox.boxID] = 1;
-                        }
-                        else
-                        {
-                            m[currBox.boxID]++;
-                        }
-                        
+                        delta = minv[c];
+                        c1 = c;
                     }
                 }
+            }
+            for (int c = 0; c <= n; ++c)
+            {
+                if (used[c])
+                {
+                    u[colRow[c]] += delta;
+                    v[c] -= delta;
+                }
+                else
+                {
+                    minv[c] -= delta;
+                }
+            }
+            c0 = c1;
+        } while (colRow[c0] != 0);
+
+        // flip the augmenting path
+        do
+        {
+            int c1 = way[c0];
+            colRow[c0] = colRow[c1];
+            c0 = c1;
+        } while (c0 != 0);
+    }
 
-            } //eof iterating all matches
-        } //eof iterating all current bounding boxes
+    assignment.assign(n, -1);
+    for (int c = 1; c <= n; ++c)
+    {
+        if (colRow[c] != 0)
+        {
+            assignment[colRow[c] - 1] = c - 1;
+        }
+    }
+}
+
+// One-to-one association of previous and current boxes which maximizes the total score over all associated pairs,
+// where a pair scores its no. of keypoint votes plus its IoU (which breaks ties between equal vote counts). Pairs
+// below minVotes or minIoU are gated out, so a box may stay unassociated. The rectangular problem is padded to a
+// square one with zero scores.
+double matchBoundingBoxesOptimal(std::vector<cv::DMatch> &matches, std::map<int, int> &bbBestMatches, DataFrame &prevFrame, DataFrame &currFrame,
+                                 int minVotes, double minIoU)
+{
+    double t = (double)cv::getTickCount();
+    cv::Mat votes = boxVoteMatrix(matches, prevFrame, currFrame);
+    int n = max(votes.rows, votes.cols);
+    vector<double> score((size_t)n * n, 0.0);
+    double maxScore = 0.0;
+    for (int p = 0; p < votes.rows; ++p)
+    {
+        const cv::Rect &prevRoi = prevFrame.boundingBoxes[p].roi;
+        for (int c = 0; c < votes.cols; ++c)
+        {
+            const cv::Rect &currRoi = currFrame.boundingBoxes[c].roi;
+            int unionArea = (prevRoi | currRoi).area();
+            double iou = unionArea > 0 ? (double)(prevRoi & currRoi).area() / unionArea : 0.0;
+            int pairVotes = votes.at<int>(p, c);
+            if (pairVotes >= max(1, minVotes) && iou >= minIoU)
+            {
+                score[(size_t)p * n + c] = pairVotes + iou;
+                maxScore = max(maxScore, pairVotes + iou);
+            }
+        }
+    }
 
-        auto bestMatch = std::max_element(m.begin(), m.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) { return a.second < b.second; });
-        bbBestMatches[prevBox.boxID] = bestMatch->first;
+    vector<double> cost(score.size());
+    for (size_t i = 0; i < score.size(); ++i)
+    {
+        cost[i] = maxScore - score[i];
+    }
+    vector<int> assignment;
+    solveAssignment(cost, n, assignment);
 
-        bool bPrint = false;
-        if (bPrint)
+    for (int p = 0; p < votes.rows; ++p)
+    {
+        int c = assignment[p];
+        if (c >= 0 && c < votes.cols && score[(size_t)p * n + c] > 0.0)
         {
-            std::cout << "ID Matching: " << prevBox.boxID << " => " << bestMatch->first << "\n";
+            bbBestMatches[prevFrame.boundingBoxes[p].boxID] = currFrame.boundingBoxes[c].boxID;
         }
     }
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    cout << "Optimal assignment of " << votes.rows << " x " << votes.cols << " boxes with " << bbBestMatches.size() << " pairs in " << 1000 * t / 1.0 << " ms" << endl;
+    return t;
 }
@@ -4,7 +4,9 @@
 
 #include <vector>
 #include <map>
+#include <cstdint>
 #include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
 
 struct LidarPoint { // single lidar point in space
     double x,y,z,r; // x,y,z in [m], r is point reflectivity
@@ -13,25 +15,35 @@ struct LidarPoint { // single lidar point in space
 struct BoundingBox { // bounding box around a classified object (contains both 2D and 3D data)
     
     int boxID; // unique identifier for this bounding box
-    int trackID; // unique identifier for the track to which this bounding box belongs
+    int trackID = -1; // unique identifier for the track to which this bounding box belongs, assigned by the TrackManager
     
     cv::Rect roi; // 2D region-of-interest in image coordinates
     int classID; // ID based on class file provided to YOLO framework
     double confidence; // classification trust
 
-    std::vector<LidarPoint> lidarPoints; // Lidar 3D points which project into 2D image roi
+    std::vector<uint32_t> lidarPointIndices; // indices into DataFrame::lidarPoints of the Lidar 3D points which project into 2D image roi
     std::vector<cv::KeyPoint> keypoints; // keypoints enclosed by 2D roi
     std::vector<cv::DMatch> kptMatches; // keypoint matches enclosed by 2D roi
 };
 
+struct ImagePyramid { // multi-scale views of a grayscale camera image, built lazily and shared by the feature stages
+
+    int maxLevel = 3;                 // index of the coarsest Gaussian level
+    cv::Size winSize = cv::Size(21, 21); // border kept around each level, so levels can feed pyramidal Lucas-Kanade directly
+
+    std::vector<cv::Mat> levels; // Gaussian levels, levels[0] is the grayscale base image
+};
+
 struct DataFrame { // represents the available sensor information at the same time instance
     
     cv::Mat cameraImg; // camera image
+    ImagePyramid pyramid; // grayscale pyramid of the camera image
     
     std::vector<cv::KeyPoint> keypoints; // 2D keypoints within camera image
     cv::Mat descriptors; // keypoint descriptors
+    cv::Ptr<cv::DescriptorMatcher> descriptorIndex; // FLANN index over the descriptors, queried by the next frame
     std::vector<cv::DMatch> kptMatches; // keypoint matches between previous and current frame
-    std::vector<LidarPoint> lidarPoints;
+    std::vector<LidarPoint> lidarPoints; // Lidar 3D points of this frame, referenced by index from each bounding box
 
     std::vector<BoundingBox> boundingBoxes; // ROI around detected objects in 2D image coordinates
     std::map<int,int> bbMatches; // bounding box matches between previous and current frame
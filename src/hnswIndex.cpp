@@ -0,0 +1,237 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <random>
+#include <opencv2/core/hal/hal.hpp>
+
+#include "hnswIndex.hpp"
+
+using namespace std;
+
+HnswIndex::HnswIndex(int dims, int M, int efConstruction, int ef, unsigned seed)
+    : dims(dims), M(M), efConstruction(efConstruction), ef(ef), seed(seed), entryPoint(-1), maxLevel(-1), buildStamp(0)
+{
+    CV_Assert(dims > 0 && M >= 2 && efConstruction >= 1 && ef >= 1);
+}
+
+int *HnswIndex::links(int id, int level)
+{
+    return level == 0 ? &bottomLinks[(size_t)id * (2 * M + 1)] : &upperLinks[id][(level - 1) * (M + 1)];
+}
+
+const int *HnswIndex::links(int id, int level) const
+{
+    return level == 0 ? &bottomLinks[(size_t)id * (2 * M + 1)] : &upperLinks[id][(level - 1) * (M + 1)];
+}
+
+float HnswIndex::distance(const float *a, int id) const
+{
+    return cv::hal::normL2Sqr_(a, data.ptr<float>(id), dims);
+}
+
+void HnswIndex::build(const cv::Mat &descriptors)
+{
+    CV_Assert(descriptors.empty() || (descriptors.type() == CV_32F && descriptors.cols == dims));
+    data = descriptors.isContinuous() ? descriptors : descriptors.clone();
+    int n = data.rows;
+    entryPoint = -1;
+    maxLevel = -1;
+
+    // layer of every descriptor from the exponential distribution with normalisation 1 / ln(M)
+    mt19937 rng(seed);
+    uniform_real_distribution<double> uniform(numeric_limits<double>::min(), 1.0);
+    double levelMult = 1.0 / log((double)M);
+    levels.resize(n);
+    upperLinks.assign(n, vector<int>());
+    for (int id = 0; id < n; id++)
+    {
+        levels[id] = (int)floor(-log(uniform(rng)) * levelMult);
+        upperLinks[id].assign(levels[id] * (M + 1), 0);
+    }
+    bottomLinks.assign((size_t)n * (2 * M + 1), 0);
+
+    buildVisited.assign(n, 0);
+    buildStamp = 0;
+    for (int id = 0; id < n; id++)
+    {
+        insert(id);
+    }
+}
+
+void HnswIndex::insert(int id)
+{
+    const float *query = data.ptr<float>(id);
+    if (entryPoint < 0)
+    {
+        entryPoint = id;
+        maxLevel = levels[id];
+        return;
+    }
+
+    // greedy descent to the top layer of the new descriptor, then link it on every layer below
+    int entry = entryPoint;
+    for (int level = maxLevel; level > levels[id]; level--)
+    {
+        entry = searchLayer(query, entry, 1, level, buildVisited, buildStamp)[0].second;
+    }
+    for (int level = min(maxLevel, levels[id]); level >= 0; level--)
+    {
+        vector<Candidate> neighbors = searchLayer(query, entry, efConstruction, level, buildVisited, buildStamp);
+        entry = neighbors[0].second;
+        selectNeighbors(neighbors, M);
+        connect(id, level, neighbors);
+    }
+
+    if (levels[id] > maxLevel)
+    {
+        entryPoint = id;
+        maxLevel = levels[id];
+    }
+}
+
+// Best-first search on one layer, returns up to ef candidates sorted by increasing distance
+vector<HnswIndex::Candidate> HnswIndex::searchLayer(const float *query, int entry, int ef, int level, vector<int> &visited, int &stamp) const
+{
+    stamp++;
+    priority_queue<Candidate, vector<Candidate>, greater<Candidate>> candidates; // closest first
+    priority_queue<Candidate> results;                                           // farthest first
+
+    float dist = distance(query, entry);
+    candidates.emplace(dist, entry);
+    results.emplace(dist, entry);
+    visited[entry] = stamp;
+
+    while (!candidates.empty())
+    {
+        Candidate current = candidates.top();
+        if (current.first > results.top().first && (int)results.size() >= ef)
+        {
+            break;
+        }
+        candidates.pop();
+
+        const int *neighbors = links(current.second, level);
+        for (int i = 1; i <= neighbors[0]; i++)
+        {
+            int id = neighbors[i];
+            if (visited[id] == stamp)
+            {
+                continue;
+            }
+            visited[id] = stamp;
+            dist = distance(query, id);
+            if ((int)results.size() < ef || dist < results.top().first)
+            {
+                candidates.emplace(dist, id);
+                results.emplace(dist, id);
+                if ((int)results.size() > ef)
+                {
+                    results.pop();
+                }
+            }
+        }
+    }
+
+    vector<Candidate> nearest(results.size());
+    for (int i = (int)nearest.size() - 1; i >= 0; i--)
+    {
+        nearest[i] = results.top();
+        results.pop();
+    }
+    return nearest;
+}
+
+// Diversity heuristic : a candidate (sorted by distance to the base) is kept only if it is closer to the base than to
+// every neighbour kept so far, so that links spread out in different directions instead of into one cluster
+void HnswIndex::selectNeighbors(vector<Candidate> &candidates, int maxLinks) const
+{
+    vector<Candidate> selected;
+    for (auto &candidate : candidates)
+    {
+        if ((int)selected.size() >= maxLinks)
+        {
+            break;
+        }
+        bool bDiverse = true;
+        for (auto &kept : selected)
+        {
+            if (distance(data.ptr<float>(candidate.second), kept.second) < candidate.first)
+            {
+                bDiverse = false;
+                break;
+            }
+        }
+        if (bDiverse)
+        {
+            selected.push_back(candidate);
+        }
+    }
+    candidates.swap(selected);
+}
+
+// Link id to its neighbours and back; a neighbour whose list is full re-selects its links including id
+void HnswIndex::connect(int id, int level, const vector<Candidate> &neighbors)
+{
+    int maxLinks = level == 0 ? 2 * M : M;
+    int *own = links(id, level);
+    own[0] = (int)neighbors.size();
+    for (size_t i = 0; i < neighbors.size(); i++)
+    {
+        own[i + 1] = neighbors[i].second;
+    }
+
+    for (auto &neighbor : neighbors)
+    {
+        int *other = links(neighbor.second, level);
+        if (other[0] < maxLinks)
+        {
+            other[++other[0]] = id;
+            continue;
+        }
+
+        const float *base = data.ptr<float>(neighbor.second);
+        vector<Candidate> candidates(1, Candidate(neighbor.first, id));
+        for (int i = 1; i <= other[0]; i++)
+        {
+            candidates.emplace_back(distance(base, other[i]), other[i]);
+        }
+        sort(candidates.begin(), candidates.end());
+        selectNeighbors(candidates, maxLinks);
+        other[0] = (int)candidates.size();
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            other[i + 1] = candidates[i].second;
+        }
+    }
+}
+
+void HnswIndex::knnMatch(const cv::Mat &queries, vector<vector<cv::DMatch>> &matches, int k) const
+{
+    CV_Assert(queries.empty() || (queries.type() == CV_32F && queries.cols == dims));
+    matches.assign(queries.rows, vector<cv::DMatch>());
+    if (entryPoint < 0)
+    {
+        return;
+    }
+
+    cv::parallel_for_(cv::Range(0, queries.rows), [&](const cv::Range &range) {
+        vector<int> visited(levels.size(), 0);
+        int stamp = 0;
+        for (int q = range.start; q < range.end; q++)
+        {
+            const float *query = queries.ptr<float>(q);
+            int entry = entryPoint;
+            for (int level = maxLevel; level > 0; level--)
+            {
+                entry = searchLayer(query, entry, 1, level, visited, stamp)[0].second;
+            }
+            vector<Candidate> nearest = searchLayer(query, entry, max(ef, k), 0, visited, stamp);
+            for (int i = 0; i < k && i < (int)nearest.size(); i++)
+            {
+                matches[q].push_back(cv::DMatch(q, nearest[i].second, sqrt(nearest[i].first)));
+            }
+        }
+    });
+}
@@ -0,0 +1,52 @@
+
+#ifndef hnswIndex_hpp
+#define hnswIndex_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <utility>
+#include <opencv2/core.hpp>
+
+// Hierarchical navigable small world graph (Malkov & Yashunin) over float descriptors such as SIFT, searched by
+// squared L2 distance. Every descriptor is linked to up to M neighbours per layer (2M on the bottom layer); the
+// neighbour lists are chosen with the diversity heuristic while inserting with a candidate list of efConstruction.
+// Queries descend greedily through the upper layers and search the bottom layer with a candidate list of ef, so
+// M / efConstruction trade build time for graph quality and ef trades query time for recall.
+class HnswIndex
+{
+  public:
+    HnswIndex(int dims = 128, int M = 16, int efConstruction = 100, int ef = 64, unsigned seed = 0x5eed);
+
+    void build(const cv::Mat &descriptors); // replaces the index by the CV_32F rows of descriptors, ids are row indices
+    void setEf(int efSearch) { ef = efSearch; }
+    size_t size() const { return levels.size(); }
+
+    // k approximate nearest neighbours, trainIdx holds the row of the indexed descriptor, distance is the L2 norm
+    void knnMatch(const cv::Mat &queries, std::vector<std::vector<cv::DMatch>> &matches, int k) const;
+
+  private:
+    typedef std::pair<float, int> Candidate; // squared distance, id
+
+    void insert(int id);
+    std::vector<Candidate> searchLayer(const float *query, int entry, int ef, int level, std::vector<int> &visited, int &stamp) const;
+    void selectNeighbors(std::vector<Candidate> &candidates, int maxLinks) const;
+    void connect(int id, int level, const std::vector<Candidate> &neighbors);
+
+    int *links(int id, int level);             // link count followed by the ids
+    const int *links(int id, int level) const;
+    float distance(const float *a, int id) const;
+
+    int dims, M, efConstruction, ef;
+    unsigned seed;
+
+    cv::Mat data;                              // indexed descriptors, one CV_32F row per id
+    std::vector<int> levels;                   // top layer of every id
+    std::vector<int> bottomLinks;              // per id 1 + 2M ints for the bottom layer
+    std::vector<std::vector<int>> upperLinks;  // per id and upper layer 1 + M ints
+    int entryPoint, maxLevel;
+
+    std::vector<int> buildVisited;
+    int buildStamp;
+};
+
+#endif /* hnswIndex_hpp */
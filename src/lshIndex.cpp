@@ -0,0 +1,165 @@
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <opencv2/core/hal/hal.hpp>
+
+#include "lshIndex.hpp"
+
+using namespace std;
+
+LshIndex::LshIndex(int descriptorBytes, int nTables, int keyBits, int probeRadius, unsigned seed)
+    : descriptorBytes(descriptorBytes), nTables(nTables), keyBits(keyBits), probeRadius(probeRadius), nAlive(0)
+{
+    CV_Assert(keyBits > 0 && keyBits <= 20 && keyBits <= 8 * descriptorBytes && probeRadius >= 0 && probeRadius <= 2);
+    bucketHead.assign((size_t)nTables << keyBits, -1);
+
+    // each table samples keyBits distinct bit positions of the descriptor
+    mt19937 rng(seed);
+    vector<int> positions(8 * descriptorBytes);
+    iota(positions.begin(), positions.end(), 0);
+    for (int t = 0; t < nTables; t++)
+    {
+        shuffle(positions.begin(), positions.end(), rng);
+        bitPositions.insert(bitPositions.end(), positions.begin(), positions.begin() + keyBits);
+    }
+}
+
+uint32_t LshIndex::hashKey(const uchar *descriptor, int table) const
+{
+    const int *positions = &bitPositions[table * keyBits];
+    uint32_t key = 0;
+    for (int b = 0; b < keyBits; b++)
+    {
+        key |= (uint32_t)((descriptor[positions[b] >> 3] >> (positions[b] & 7)) & 1) << b;
+    }
+    return key;
+}
+
+vector<int> LshIndex::insert(const cv::Mat &descriptors)
+{
+    CV_Assert(descriptors.empty() || (descriptors.type() == CV_8U && descriptors.cols == descriptorBytes));
+    vector<int> ids;
+    for (int i = 0; i < descriptors.rows; i++)
+    {
+        int id;
+        if (!freeIds.empty())
+        {
+            id = freeIds.back();
+            freeIds.pop_back();
+        }
+        else
+        {
+            id = (int)bAlive.size();
+            bAlive.push_back(0);
+            data.resize(data.size() + descriptorBytes);
+            keys.resize(keys.size() + nTables);
+            nextId.resize(nextId.size() + nTables);
+            prevId.resize(prevId.size() + nTables);
+        }
+
+        // push the id to the front of its bucket in every table
+        const uchar *row = descriptors.ptr<uchar>(i);
+        copy(row, row + descriptorBytes, data.begin() + (size_t)id * descriptorBytes);
+        for (int t = 0; t < nTables; t++)
+        {
+            size_t link = (size_t)id * nTables + t;
+            keys[link] = hashKey(row, t);
+            int &head = bucketHead[((size_t)t << keyBits) + keys[link]];
+            nextId[link] = head;
+            prevId[link] = -1;
+            if (head >= 0)
+            {
+                prevId[(size_t)head * nTables + t] = id;
+            }
+            head = id;
+        }
+        bAlive[id] = 1;
+        ids.push_back(id);
+        nAlive++;
+    }
+    return ids;
+}
+
+void LshIndex::remove(const vector<int> &ids)
+{
+    for (int id : ids)
+    {
+        if (id >= 0 && id < (int)bAlive.size() && bAlive[id])
+        {
+            // unlink the id from its bucket in every table
+            for (int t = 0; t < nTables; t++)
+            {
+                size_t link = (size_t)id * nTables + t;
+                int next = nextId[link], prev = prevId[link];
+                if (prev >= 0)
+                {
+                    nextId[(size_t)prev * nTables + t] = next;
+                }
+                else
+                {
+                    bucketHead[((size_t)t << keyBits) + keys[link]] = next;
+                }
+                if (next >= 0)
+                {
+                    prevId[(size_t)next * nTables + t] = prev;
+                }
+            }
+            bAlive[id] = 0;
+            freeIds.push_back(id);
+            nAlive--;
+        }
+    }
+}
+
+void LshIndex::knnMatch(const cv::Mat &queries, vector<vector<cv::DMatch>> &matches, int k) const
+{
+    CV_Assert(queries.empty() || (queries.type() == CV_8U && queries.cols == descriptorBytes));
+    matches.assign(queries.rows, vector<cv::DMatch>());
+
+    // probe sequence as key flips : the bucket itself, then all keys within probeRadius bits
+    vector<uint32_t> probes(1, 0);
+    for (int b1 = 0; b1 < keyBits && probeRadius >= 1; b1++)
+    {
+        probes.push_back(1u << b1);
+        for (int b2 = b1 + 1; b2 < keyBits && probeRadius >= 2; b2++)
+        {
+            probes.push_back((1u << b1) | (1u << b2));
+        }
+    }
+
+    cv::parallel_for_(cv::Range(0, queries.rows), [&](const cv::Range &range) {
+        vector<int> visited(bAlive.size(), -1); // last query which visited an id
+        for (int q = range.start; q < range.end; q++)
+        {
+            const uchar *query = queries.ptr<uchar>(q);
+            vector<cv::DMatch> &best = matches[q]; // sorted by distance, at most k entries
+            for (int t = 0; t < nTables; t++)
+            {
+                uint32_t key = hashKey(query, t);
+                const int *heads = &bucketHead[(size_t)t << keyBits];
+                for (uint32_t flip : probes)
+                {
+                    for (int id = heads[key ^ flip]; id >= 0; id = nextId[(size_t)id * nTables + t])
+                    {
+                        if (visited[id] == q)
+                        {
+                            continue;
+                        }
+                        visited[id] = q;
+                        float dist = (float)cv::hal::normHamming(query, &data[(size_t)id * descriptorBytes], descriptorBytes);
+                        if ((int)best.size() < k || dist < best.back().distance)
+                        {
+                            auto pos = upper_bound(best.begin(), best.end(), dist, [](float d, const cv::DMatch &m) { return d < m.distance; });
+                            best.insert(pos, cv::DMatch(q, id, dist));
+                            if ((int)best.size() > k)
+                            {
+                                best.pop_back();
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
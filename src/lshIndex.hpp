@@ -0,0 +1,43 @@
+
+#ifndef lshIndex_hpp
+#define lshIndex_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <cstdint>
+#include <opencv2/core.hpp>
+
+// Multi-probe locality sensitive hashing index for binary descriptors (e.g. 256 bit ORB / BRIEF, 512 bit BRISK / FREAK).
+// Every table hashes a descriptor to the keyBits bits at fixed random positions; a query visits its own bucket and,
+// with probeRadius 1 or 2, all buckets whose key differs in up to that many bits. Buckets are doubly linked lists of
+// descriptor ids held in flat arrays (one head per bucket, one next / prev link per id and table), so descriptors
+// can be inserted and removed at any time in O(nTables) each, e.g. to index a sliding window of frames, without
+// reallocating or re-sorting the tables. keyBits is limited to 20, i.e. 2^20 bucket heads per table.
+class LshIndex
+{
+  public:
+    LshIndex(int descriptorBytes = 32, int nTables = 8, int keyBits = 14, int probeRadius = 1, unsigned seed = 0x5eed);
+
+    std::vector<int> insert(const cv::Mat &descriptors); // returns the ids of the inserted rows
+    void remove(const std::vector<int> &ids);
+    size_t size() const { return nAlive; }
+
+    // k nearest neighbours by Hamming distance among the probed candidates, trainIdx holds the descriptor id
+    void knnMatch(const cv::Mat &queries, std::vector<std::vector<cv::DMatch>> &matches, int k) const;
+
+  private:
+    uint32_t hashKey(const uchar *descriptor, int table) const;
+
+    int descriptorBytes, nTables, keyBits, probeRadius;
+    std::vector<int> bitPositions;     // nTables x keyBits descriptor bit indices
+    std::vector<uchar> data;           // descriptor rows by id
+    std::vector<uint32_t> keys;        // nTables keys per id
+    std::vector<uchar> bAlive;         // false for removed ids, whose slots are reused by later inserts
+    std::vector<int> freeIds;
+    size_t nAlive;
+
+    std::vector<int> bucketHead;       // per table 2^keyBits first ids, -1 for empty buckets
+    std::vector<int> nextId, prevId;   // nTables links per id, -1 at the ends of a bucket
+};
+
+#endif /* lshIndex_hpp */
@@ -13,16 +13,78 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/features2d.hpp>
+#include <opencv2/video/tracking.hpp>
 #include <opencv2/xfeatures2d.hpp>
 #include <opencv2/xfeatures2d/nonfree.hpp>
 
 #include "dataStructures.h"
 
 
+struct KeypointBudget { // state of the adaptive keypoint budget controller, carried from frame to frame
+    int targetKeypoints;  // desired number of keypoints per frame
+    double gain;          // fraction of the log-scale count error corrected per frame
+    int gridCols;         // grid used for spatially balanced selection of surplus keypoints
+    int gridRows;
+    int logStep;          // detector threshold offset from the detector default in 1/8 octave steps
+    double threshold;     // detector threshold applied to the last frame
+
+    KeypointBudget(int target = 500, double ctrlGain = 0.5, int cols = 8, int rows = 4)
+        : targetKeypoints(target), gain(ctrlGain), gridCols(cols), gridRows(rows), logStep(0), threshold(-1) {}
+};
+
+struct KltTracking { // state of the optical flow tracking mode, carried from frame to frame
+    int minTracks;            // keypoints are replenished by detection when fewer tracks survive
+    int redetectInterval;     // keypoints are replenished at least every n frames
+    double maxFbError;        // max. forward-backward tracking error in pixels
+    int minDistance;          // min. distance in pixels between a replenished keypoint and existing tracks
+    int framesSinceDetection; // frames since the last replenishment
+
+    KltTracking(int minTrackCount = 300, int interval = 10, double fbError = 1.0, int distance = 8)
+        : minTracks(minTrackCount), redetectInterval(interval), maxFbError(fbError), minDistance(distance), framesSinceDetection(0) {}
+};
+
+struct SiftQuantizer { // conversion of float SIFT descriptors into compact uint8 vectors for integer L2 matching
+    bool bRootSift;  // apply RootSIFT (L1 normalization and element-wise square root) before quantization
+    cv::PCA pca;     // optional projection fitted offline, empty to keep all 128 dimensions
+    float pcaScale;  // scale from projected coordinates into the signed 8 bit range
+
+    SiftQuantizer(bool rootSift = false) : bRootSift(rootSift), pcaScale(1.f) {}
+};
+
+cv::Ptr<cv::FeatureDetector> getDetector(std::string detectorType, double threshold=-1);
+cv::Ptr<cv::DescriptorExtractor> getExtractor(std::string descriptorType);
+double getEngineConstructionTime();
+
+cv::Mat &getGrayImage(DataFrame &frame);
+cv::Mat &getPyramidLevel(ImagePyramid &pyramid, int level);
+
 double detKeypointsHarris(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool bVis=false);
 double detKeypointsShiTomasi(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool bVis=false);
-double detKeypointsModern(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, std::string detectorType, bool bVis=false);
+double detKeypointsModern(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, std::string detectorType, bool bVis=false, const cv::Mat &thresholdGrid=cv::Mat());
+bool isFusedFeatureType(std::string detectorType, std::string descriptorType);
+double detectAndDescribe(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &descriptors, std::string featureType);
 double descKeypoints(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &descriptors, std::string descriptorType);
+double descKeypointsParallel(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &descriptors, std::string descriptorType, int nPartitions=0);
+double detKeypointsTiled(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, std::string detectorType, int tilesX, int tilesY, int overlap, int maxKeypoints=0);
+double detKeypointsBudget(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, std::string detectorType, KeypointBudget &budget, bool bVis=false);
+void retainBestBucketed(std::vector<cv::KeyPoint> &keypoints, int maxKeypoints, cv::Size imgSize, int gridCols, int gridRows);
+double trackKeypointsKLT(std::vector<cv::KeyPoint> &kptsPrev, ImagePyramid &pyramidPrev, std::vector<cv::KeyPoint> &kptsCurr, ImagePyramid &pyramidCurr,
+                         std::vector<cv::DMatch> &matches, std::string detectorType, KltTracking &tracking);
+std::vector<cv::Rect> computeDetectionRois(std::vector<BoundingBox> &boundingBoxes, cv::Size imgSize, int padding);
+double detKeypointsInRois(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, std::vector<cv::Rect> &rois, std::string detectorType);
+double descKeypointsInRois(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &descriptors, std::vector<cv::Rect> &rois, std::string descriptorType);
+void fitSiftPca(SiftQuantizer &quantizer, cv::Mat &samples, int dims=64);
+void saveSiftPca(SiftQuantizer &quantizer, std::string fileName);
+bool loadSiftPca(SiftQuantizer &quantizer, std::string fileName);
+double quantizeSiftDescriptors(cv::Mat &descriptors, SiftQuantizer &quantizer);
+void predictKeypointFlow(std::vector<cv::KeyPoint> &kptsPrevPrev, DataFrame &framePrev, std::vector<cv::Point2f> &flow);
+double matchDescriptorsWindowed(std::vector<cv::KeyPoint> &kPtsSource, std::vector<cv::KeyPoint> &kPtsRef, cv::Mat &descSource, cv::Mat &descRef,
+                                std::vector<cv::DMatch> &matches, std::string descriptorType, std::string selectorType,
+                                float searchRadius, std::vector<cv::Point2f> &flow);
+double matchDescriptorsInBoxPairs(std::vector<BoundingBox> &boxesPrevPrev, DataFrame &framePrev, DataFrame &frameCurr, std::vector<cv::DMatch> &matches,
+                                  std::string descriptorType, std::string matcherType, std::string selectorType);
+double buildDescriptorIndex(DataFrame &frame, std::string descriptorType);
+double matchDescriptorsWithIndex(DataFrame &framePrev, cv::Mat &descCurr, std::vector<cv::DMatch> &matches, std::string descriptorType, std::string selectorType);
 void matchDescriptors(std::vector<cv::KeyPoint> &kPtsSource, std::vector<cv::KeyPoint> &kPtsRef, cv::Mat &descSource, cv::Mat &descRef,
                       std::vector<cv::DMatch> &matches, std::string descriptorType, std::string matcherType, std::string selectorType);
 
@@ -1,68 +1,131 @@
   #include <numeric>
+#include <algorithm>
+#include <cfloat>
+#include <set>
+#include <opencv2/core/hal/hal.hpp>
 #include "matching2D.hpp"
+#include "simdFeatures.hpp"
+#include "lshIndex.hpp"
+#include "hnswIndex.hpp"
 
 using namespace std;
 
-// Find best matches for keypoints in two camera images based on several matching methods
-void matchDescriptors(std::vector<cv::KeyPoint> &kPtsSource, std::vector<cv::KeyPoint> &kPtsRef, cv::Mat &descSource, cv::Mat &descRef,
-                      std::vector<cv::DMatch> &matches, std::string descriptorType, std::string matcherType, std::string selectorType)
-{
-    // configure matcher
-    bool crossCheck = false;
-    cv::Ptr<cv::DescriptorMatcher> matcher;
+// Feature engines are built once per type and parameter set and handed out for the whole run,
+// since several of them precompute sampling patterns or lookup tables at construction
+static map<string, cv::Ptr<cv::FeatureDetector>> detectorRegistry;
+static map<string, cv::Ptr<cv::DescriptorExtractor>> extractorRegistry;
+static set<string> warmedUpExtractors; // extractors already run once serially, see descKeypointsParallel
+static double engineConstructionTime = 0.0; // accumulated construction time of all engines in s
 
-    if (matcherType.compare("MAT_BF") == 0)
+// Default detection threshold of a detector type, in the unit the detector expects
+static double defaultDetectorThreshold(const string &detectorType)
+{
+    if (detectorType.compare("FAST") == 0 || detectorType.compare("FAST_SIMD") == 0 || detectorType.compare("BRISK") == 0)
     {
-        // with SIFT (DES_HOG), normType = cv::NORM_L2; with all other DES_BINARY descriptors, normType = cv::NORM_HAMMING
-        int normType = descriptorType.compare("DES_BINARY") == 0 ? cv::NORM_HAMMING : cv::NORM_L2;
-        matcher = cv::BFMatcher::create(normType, crossCheck);
+        return 30; // intensity difference between the central pixel and the pixels on the circle
     }
-    else if (matcherType.compare("MAT_FLANN") == 0)
+    else if (detectorType.compare("ORB") == 0)
     {
-        if (descSource.type() != CV_32F)
-        { // OpenCV bug workaround : convert binary descriptors to floating point due to a bug in current OpenCV implementation
-            descSource.convertTo(descSource, CV_32F);
-            descRef.convertTo(descRef, CV_32F);
-        }
+        return 20; // FAST threshold of the ORB pyramid levels
+    }
+    else if (detectorType.compare("AKAZE") == 0)
+    {
+        return 0.001; // detector response threshold
+    }
+    else if (detectorType.compare("SIFT") == 0)
+    {
+        return 0.04; // contrast threshold
+    }
+    else if (detectorType.compare("HARRIS") == 0)
+    {
+        return 100; // minimum value for a corner in the 8bit scaled response matrix
+    }
+    else if (detectorType.compare("SHITOMASI") == 0)
+    {
+        return 0.01; // minimal accepted quality of image corners
+    }
+    return -1;
+}
 
-        //Implement FLANN matching
-        if (descriptorType.compare("DES_HOG") == 0)
-        {
-            matcher = cv::FlannBasedMatcher::create();
-        }
-        else if (descriptorType.compare("DES_BINARY") == 0)
-        {
-            const cv::Ptr<cv::flann::IndexParams>& indexParams = cv::makePtr<cv::flann::LshIndexParams>(12, 20, 2);
-            matcher = cv::makePtr<cv::FlannBasedMatcher>(indexParams);
-        }
+// True for detector types implemented by an OpenCV engine from the registry rather than by a function of our own
+static bool isRegistryDetector(const string &detectorType)
+{
+    return detectorType.compare("SHITOMASI") != 0 && detectorType.compare("HARRIS") != 0 && detectorType.compare("FAST_SIMD") != 0;
+}
+
+// Return the detector for the given type and threshold, building it on first use
+cv::Ptr<cv::FeatureDetector> getDetector(string detectorType, double threshold)
+{
+    if (threshold < 0)
+    {
+        threshold = defaultDetectorThreshold(detectorType);
     }
 
-    // perform matching task
-    if (selectorType.compare("SEL_NN") == 0)
-    { // nearest neighbor (best match)
+    // quantize to the precision the engine takes, so thresholds which build equal engines share one registry entry
+    if (detectorType.compare("FAST") == 0 || detectorType.compare("BRISK") == 0 || detectorType.compare("ORB") == 0)
+    {
+        threshold = (int)threshold;
+    }
+    else if (detectorType.compare("AKAZE") == 0)
+    {
+        threshold = (float)threshold;
+    }
+    ostringstream keyStream;
+    keyStream << detectorType << ":" << setprecision(17) << threshold;
+    string key = keyStream.str();
+    auto it = detectorRegistry.find(key);
+    if (it != detectorRegistry.end())
+    {
+        return it->second;
+    }
 
-        matcher->match(descSource, descRef, matches); // Finds the best match for each descriptor in desc1
+    double t = (double)cv::getTickCount();
+    cv::Ptr<cv::FeatureDetector> detector;
+    if (detectorType.compare("FAST") == 0)
+    {
+        bool bNMS = true;   // perform non-maxima suppression on keypoints
+        cv::FastFeatureDetector::DetectorType type = cv::FastFeatureDetector::TYPE_9_16; // TYPE_9_16, TYPE_7_12, TYPE_5_8
+        detector = cv::FastFeatureDetector::create((int)threshold, bNMS, type);
     }
-    else if (selectorType.compare("SEL_KNN") == 0)
-    { // k nearest neighbors (k=2)
-        vector<vector<cv::DMatch>> knn_matches;
-        matcher->knnMatch(descSource, descRef, knn_matches, 2); // find the 2 best matches
-        double minDescDistRatio = 0.8;
-        for (auto it = knn_matches.begin(); it != knn_matches.end(); ++it)
-        {
-            if ((*it)[0].distance < minDescDistRatio * (*it)[1].distance)
-            {
-                matches.push_back((*it)[0]);
-            }
-        }
-        cout << "# keypoints removed = " << knn_matches.size() - matches.size() << endl;        
+    else if (detectorType.compare("BRISK") == 0)
+    {
+        detector = cv::BRISK::create((int)threshold);
+    }
+    else if (detectorType.compare("ORB") == 0)
+    {
+        detector = cv::ORB::create(500, 1.2f, 8, 31, 0, 2, cv::ORB::HARRIS_SCORE, 31, (int)threshold);
+    }
+    else if (detectorType.compare("AKAZE") == 0)
+    {
+        detector = cv::AKAZE::create(cv::AKAZE::DESCRIPTOR_MLDB, 0, 3, (float)threshold);
+    }
+    else if (detectorType.compare("SIFT") == 0)
+    {
+        detector = cv::xfeatures2d::SIFT::create(0, 3, threshold);
+    }
+    else
+    {
+        std::cout << "Invalid Keypoints Detector .\n";
+        return detector;
     }
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    engineConstructionTime += t;
+    cout << detectorType << " detector construction in " << 1000 * t / 1.0 << " ms" << endl;
+
+    detectorRegistry[key] = detector;
+    return detector;
 }
 
-// Use one of several types of state-of-art descriptors to uniquely identify keypoints
-double descKeypoints(vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &descriptors, string descriptorType)
+// Return the descriptor extractor for the given type, building it on first use
+cv::Ptr<cv::DescriptorExtractor> getExtractor(string descriptorType)
 {
-    // select appropriate descriptor
+    auto it = extractorRegistry.find(descriptorType);
+    if (it != extractorRegistry.end())
+    {
+        return it->second;
+    }
+
+    double t = (double)cv::getTickCount();
     cv::Ptr<cv::DescriptorExtractor> extractor;
     if (descriptorType.compare("BRISK") == 0)
     {
@@ -73,11 +136,15 @@ double descKeypoints(vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &des
 
         extractor = cv::BRISK::create(threshold, octaves, patternScale);
     }
-    // BRIEF, ORB, FREAK, AKAZE, SIFT
+    // BRIEF, BRIEF_SIMD, ORB, FREAK, AKAZE, SIFT
     else if (descriptorType.compare("BRIEF") == 0)
     {
         extractor = cv::xfeatures2d::BriefDescriptorExtractor::create();
     }
+    else if (descriptorType.compare("BRIEF_SIMD") == 0)
+    {
+        extractor = BriefSimdExtractor::create();
+    }
     else if (descriptorType.compare("ORB") == 0)
     {
         extractor = cv::ORB::create();
@@ -94,176 +161,1744 @@ double descKeypoints(vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &des
     {
         extractor = cv::xfeatures2d::SIFT::create();
     }
-    // perform feature description
-    double t = (double)cv::getTickCount();
-    extractor->compute(img, keypoints, descriptors);
+    else
+    {
+        std::cout << "Invalid Keypoints Descriptor .\n";
+        return extractor;
+    }
     t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
-    cout << descriptorType << " descriptor extraction in " << 1000 * t / 1.0 << " ms" << endl;
-    return t;
+    engineConstructionTime += t;
+    cout << descriptorType << " descriptor construction in " << 1000 * t / 1.0 << " ms" << endl;
+
+    extractorRegistry[descriptorType] = extractor;
+    return extractor;
 }
 
-// Detect keypoints in image using the traditional Shi-Thomasi detector
-double detKeypointsShiTomasi(vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool bVis)
+// Total time spent constructing feature engines, reported separately from the per-frame cost
+double getEngineConstructionTime()
 {
-    // compute detector parameters based on image size
-    int blockSize = 4;       //  size of an average block for computing a derivative covariation matrix over each pixel neighborhood
-    double maxOverlap = 0.0; // max. permissible overlap between two features in %
-    double minDistance = (1.0 - maxOverlap) * blockSize;
-    int maxCorners = img.rows * img.cols / max(1.0, minDistance); // max. num. of keypoints
+    return engineConstructionTime;
+}
 
-    double qualityLevel = 0.01; // minimal accepted quality of image corners
-    double k = 0.04;
+// RootSIFT : L1-normalize each descriptor and take the element-wise square root, so that the L2 distance of the
+// result compares histograms like the Hellinger kernel
+static void rootSift(cv::Mat &descriptors)
+{
+    for (int i = 0; i < descriptors.rows; ++i)
+    {
+        float *d = descriptors.ptr<float>(i);
+        double l1 = 0.0;
+        for (int j = 0; j < descriptors.cols; ++j)
+        {
+            l1 += fabs(d[j]);
+        }
+        for (int j = 0; j < descriptors.cols; ++j)
+        {
+            d[j] = (float)sqrt(fabs(d[j]) / max(l1, 1e-7));
+        }
+    }
+}
 
-    // Apply corner detection
-    double t = (double)cv::getTickCount();
-    vector<cv::Point2f> corners;
-    cv::goodFeaturesToTrack(img, corners, maxCorners, qualityLevel, minDistance, cv::Mat(), blockSize, false, k);
+// Fit the PCA projection of a quantizer on sample SIFT descriptors (one per row, CV_32F). The quantization scale
+// maps +/- 3 standard deviations of the strongest component onto the signed 8 bit range.
+void fitSiftPca(SiftQuantizer &quantizer, cv::Mat &samples, int dims)
+{
+    cv::Mat data = samples.clone();
+    if (quantizer.bRootSift)
+    {
+        rootSift(data);
+    }
+    quantizer.pca = cv::PCA(data, cv::Mat(), cv::PCA::DATA_AS_ROW, dims);
+    quantizer.pcaScale = 127.f / (3.f * sqrt(quantizer.pca.eigenvalues.at<float>(0)));
+}
+
+void saveSiftPca(SiftQuantizer &quantizer, std::string fileName)
+{
+    cv::FileStorage fs(fileName, cv::FileStorage::WRITE);
+    quantizer.pca.write(fs);
+    fs << "pcaScale" << quantizer.pcaScale;
+    fs << "rootSift" << (int)quantizer.bRootSift;
+}
 
-    // add corners to result vector
-    for (auto it = corners.begin(); it != corners.end(); ++it)
+bool loadSiftPca(SiftQuantizer &quantizer, std::string fileName)
+{
+    cv::FileStorage fs(fileName, cv::FileStorage::READ);
+    if (!fs.isOpened())
     {
+        cout << "Could not load SIFT PCA from " << fileName << endl;
+        return false;
+    }
+    quantizer.pca.read(fs.root());
+    fs["pcaScale"] >> quantizer.pcaScale;
+    int rootSift = 0;
+    fs["rootSift"] >> rootSift;
+    quantizer.bRootSift = rootSift != 0;
+    return true;
+}
 
-        cv::KeyPoint newKeyPoint;
-        newKeyPoint.pt = cv::Point2f((*it).x, (*it).y);
-        newKeyPoint.size = blockSize;
-        keypoints.push_back(newKeyPoint);
+// Replace float SIFT descriptors by uint8 vectors, which are matched with descriptorType DES_HOG_U8. Plain SIFT
+// values already lie in [0, 255] and are stored without loss; RootSIFT values are scaled from [0, 1]. With a
+// PCA, the projected coordinates are scaled and offset by 128, which cancels out in all distances.
+double quantizeSiftDescriptors(cv::Mat &descriptors, SiftQuantizer &quantizer)
+{
+    if (descriptors.empty() || descriptors.type() != CV_32F)
+    {
+        return 0.0;
     }
-    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
-    cout << "Shi-Tomasi detection with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
 
-    // visualize results
-    if (bVis)
+    double t = (double)cv::getTickCount();
+    cv::Mat desc = descriptors;
+    if (quantizer.bRootSift)
     {
-        cv::Mat visImage = img.clone();
-        cv::drawKeypoints(img, keypoints, visImage, cv::Scalar::all(-1), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
-        string windowName = "Shi-Tomasi Corner Detector Results";
-        cv::namedWindow(windowName, 6);
-        imshow(windowName, visImage);
-        cv::waitKey(0);
+        desc = descriptors.clone();
+        rootSift(desc);
     }
+
+    cv::Mat quantized;
+    if (!quantizer.pca.eigenvectors.empty())
+    {
+        cv::Mat projected = quantizer.pca.project(desc);
+        projected.convertTo(quantized, CV_8U, quantizer.pcaScale, 128);
+    }
+    else
+    {
+        desc.convertTo(quantized, CV_8U, quantizer.bRootSift ? 255.0 : 1.0);
+    }
+    size_t bytesBefore = descriptors.total() * descriptors.elemSize();
+    descriptors = quantized;
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    cout << "SIFT quantization to " << descriptors.cols << " x uint8 (" << bytesBefore / 1024 << " kB -> "
+         << descriptors.total() / 1024 << " kB) in " << 1000 * t / 1.0 << " ms" << endl;
     return t;
 }
 
-double detKeypointsHarris(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool bVis)
+// Brute force k-nearest-neighbour search for uint8 descriptors (see quantizeSiftDescriptors) with the integer
+// L2 kernel, in parallel over the source descriptors. Distances are reported as L2 norms like cv::BFMatcher.
+static void knnMatchL2U8(const cv::Mat &descSource, const cv::Mat &descRef, vector<vector<cv::DMatch>> &knnMatches, int k)
 {
-    // Detector parameters
-    int blockSize = 4;     // for every pixel, a blockSize × blockSize neighborhood is considered
-    int apertureSize = 3;  // aperture parameter for Sobel operator (must be odd)
-    int minResponse = 100; // minimum value for a corner in the 8bit scaled response matrix
-    double k = 0.04;       // Harris parameter (see equation for details)
+    CV_Assert(descSource.type() == CV_8U && descRef.type() == CV_8U && descSource.cols == descRef.cols);
+    knnMatches.assign(descSource.rows, vector<cv::DMatch>());
+    cv::parallel_for_(cv::Range(0, descSource.rows), [&](const cv::Range &range) {
+        for (int i = range.start; i < range.end; ++i)
+        {
+            const uchar *query = descSource.ptr<uchar>(i);
+            vector<cv::DMatch> &best = knnMatches[i]; // sorted by distance, at most k entries
+            for (int j = 0; j < descRef.rows; ++j)
+            {
+                float dist = (float)normL2SqrU8(query, descRef.ptr<uchar>(j), descRef.cols);
+                if ((int)best.size() < k || dist < best.back().distance)
+                {
+                    auto pos = upper_bound(best.begin(), best.end(), dist, [](float d, const cv::DMatch &m) { return d < m.distance; });
+                    best.insert(pos, cv::DMatch(i, j, dist));
+                    if ((int)best.size() > k)
+                    {
+                        best.pop_back();
+                    }
+                }
+            }
+            for (auto &match : best)
+            {
+                match.distance = sqrt(match.distance);
+            }
+        }
+    });
+}
 
-    // Detect Harris corners and normalize output
-    cv::Mat dst, dst_norm, dst_norm_scaled;
-    dst = cv::Mat::zeros(img.size(), CV_32FC1);
+// Brute force L2 matching of float descriptors (SIFT) with distances expanded as ||a||^2 + ||b||^2 - 2 a.b, where
+// the dot products of a block of source rows with a block of reference rows come from one matrix multiply.
+// Blocks of source rows are processed in parallel; each source row keeps a running top 2 over all reference
+// blocks, and the ratio test on the L2 distances is applied in the same pass (minDescDistRatio <= 0 returns
+// the nearest neighbour of every source row instead). Matches are ordered by source index.
+static void matchL2Gemm(const cv::Mat &descSource, const cv::Mat &descRef, vector<cv::DMatch> &matches, double minDescDistRatio)
+{
+    if (descSource.empty() || descRef.empty())
+    { // e.g. a frame without keypoints in ROI or tiled mode
+        return;
+    }
+    CV_Assert(descSource.type() == CV_32F && descRef.type() == CV_32F && descSource.cols == descRef.cols);
+    const int queryBlock = 256; // source rows per matrix multiply
+    const int trainBlock = 512; // reference rows per matrix multiply, 256 kB of SIFT descriptors
+    int nQuery = descSource.rows, nTrain = descRef.rows;
+    int nQueryBlocks = (nQuery + queryBlock - 1) / queryBlock;
 
-    double t = (double)cv::getTickCount();
-    cv::cornerHarris(img, dst, blockSize, apertureSize, k, cv::BORDER_DEFAULT);
-    cv::normalize(dst, dst_norm, 0, 255, cv::NORM_MINMAX, CV_32FC1, cv::Mat());
-    cv::convertScaleAbs(dst_norm, dst_norm_scaled);
+    // squared norms of all source and reference rows
+    cv::Mat normsSource, normsRef;
+    cv::reduce(descSource.mul(descSource), normsSource, 1, cv::REDUCE_SUM, CV_32F);
+    cv::reduce(descRef.mul(descRef), normsRef, 1, cv::REDUCE_SUM, CV_32F);
 
-    // Locate local maxima in the Harris response matrix 
-    // and perform a non-maximum suppression (NMS) in a local neighborhood around 
-    // each maximum. The resulting coordinates shall be stored in a list of keypoints 
-    // of the type `vector<cv::KeyPoint>`.
-    double maxOverlap = 0.0; // max permissible overlap between two features in %, used during non-maxima suppression
-    for (size_t j = 0; j < dst_norm.rows; j++)
-    {
-        for (size_t i = 0; i < dst_norm.cols; i++)
-        {
-            int response = (int)dst_norm.at<float>(j, i);
-            if (response > minResponse)
-            { // only store points above a threshold
-                cv::KeyPoint newKeyPoint;
-                newKeyPoint.pt = cv::Point2f(i, j);
-                newKeyPoint.size = 2 * apertureSize;
-                newKeyPoint.response = response;
-
-                // perform non-maximum suppression (NMS) in local neighbourhood around new key point
-                bool bOverlap = false;
-                for (auto it = keypoints.begin(); it != keypoints.end(); ++it)
+    // ratio test on squared distances
+    float ratioSqr = (float)(minDescDistRatio * minDescDistRatio);
+    vector<cv::DMatch> best(nQuery);
+    vector<uchar> bValid(nQuery, 0);
+    cv::parallel_for_(cv::Range(0, nQueryBlocks), [&](const cv::Range &range) {
+        cv::Mat dots;
+        for (int block = range.start; block < range.end; ++block)
+        {
+            int q0 = block * queryBlock, q1 = min(nQuery, q0 + queryBlock);
+            vector<float> best1(q1 - q0, numeric_limits<float>::max()), best2(q1 - q0, numeric_limits<float>::max());
+            vector<int> bestIdx(q1 - q0, -1);
+
+            for (int t0 = 0; t0 < nTrain; t0 += trainBlock)
+            {
+                int t1 = min(nTrain, t0 + trainBlock);
+                cv::gemm(descSource.rowRange(q0, q1), descRef.rowRange(t0, t1), 1.0, cv::noArray(), 0.0, dots, cv::GEMM_2_T);
+                const float *nRef = normsRef.ptr<float>(t0);
+                for (int q = q0; q < q1; ++q)
                 {
-                    double kptOverlap = cv::KeyPoint::overlap(newKeyPoint, *it);
-                    if (kptOverlap > maxOverlap)
+                    const float *dot = dots.ptr<float>(q - q0);
+                    float nQ = normsSource.at<float>(q);
+                    float b1 = best1[q - q0], b2 = best2[q - q0];
+                    int bi = bestIdx[q - q0];
+                    for (int t = 0; t < t1 - t0; ++t)
                     {
-                        bOverlap = true;
-                        if (newKeyPoint.response > (*it).response)
-                        {                       // if overlap is > threshold AND response is higher for new kpt
-                            *it = newKeyPoint;  // replace old key point with new one
-                            break;              // quit loop over keypoints
+                        float distSqr = nQ + nRef[t] - 2.f * dot[t];
+                        if (distSqr < b2)
+                        {
+                            if (distSqr < b1)
+                            {
+                                b2 = b1;
+                                b1 = distSqr;
+                                bi = t0 + t;
+                            }
+                            else
+                            {
+                                b2 = distSqr;
+                            }
                         }
                     }
+                    best1[q - q0] = b1;
+                    best2[q - q0] = b2;
+                    bestIdx[q - q0] = bi;
                 }
-                if (!bOverlap)
+            }
+
+            for (int q = q0; q < q1; ++q)
+            {
+                float b1 = max(0.f, best1[q - q0]), b2 = best2[q - q0]; // rounding may push near-zero distances below 0
+                if (bestIdx[q - q0] >= 0 && (minDescDistRatio <= 0 || (b2 != numeric_limits<float>::max() && b1 < ratioSqr * b2)))
                 {
-                    keypoints.push_back(newKeyPoint);
+                    best[q] = cv::DMatch(q, bestIdx[q - q0], sqrt(b1));
+                    bValid[q] = 1;
                 }
             }
+        }
+    });
 
-        } // eof loop over cols
-    }       
-    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
-    cout << "Harris detection with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
-
-    // visualize results
-    if (bVis)
+    for (int q = 0; q < nQuery; ++q)
     {
-        cv::Mat visImage = img.clone();
-        cv::drawKeypoints(img, keypoints, visImage, cv::Scalar::all(-1), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
-        string windowName = "Harris Corner Detector Results";
-        cv::namedWindow(windowName, 6);
-        imshow(windowName, visImage);
-        cv::waitKey(0);
+        if (bValid[q])
+        {
+            matches.push_back(best[q]);
+        }
     }
-    return t;
 }
 
-double detKeypointsModern(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, std::string detectorType, bool bVis)
-{   // Detect keypoints using modern detectors FAST, BRISK, ORB, AKAZE, SIFT
-    double t = (double)cv::getTickCount();
+// FLANN matcher for a descriptor type : LSH index for binary descriptors, randomized KD-trees for SIFT, where
+// uint8 SIFT (DES_HOG_U8) has to be converted to float by the caller
+static cv::Ptr<cv::FlannBasedMatcher> createFlannMatcher(const string &descriptorType)
+{
+    if (descriptorType.compare("DES_BINARY") == 0)
+    {
+        const cv::Ptr<cv::flann::IndexParams>& indexParams = cv::makePtr<cv::flann::LshIndexParams>(12, 20, 2);
+        return cv::makePtr<cv::FlannBasedMatcher>(indexParams);
+    }
+    CV_Assert(descriptorType.compare("DES_HOG") == 0 || descriptorType.compare("DES_HOG_U8") == 0);
+    return cv::FlannBasedMatcher::create();
+}
 
-    cv::Ptr<cv::FeatureDetector> detector;
-    if (detectorType.compare("FAST") == 0)
+// k nearest neighbours of binary descriptors from a multi-probe LSH index built over the reference descriptors
+static void knnMatchLsh(const cv::Mat &descSource, const cv::Mat &descRef, vector<vector<cv::DMatch>> &knnMatches, int k)
+{
+    knnMatches.assign(descSource.rows, vector<cv::DMatch>());
+    if (descRef.empty())
     {
-        int threshold = 30; // difference between intensity of the central pixel and pixels of a circle around this pixel
-        bool bNMS = true;   // perform non-maxima suppression on keypoints
-        cv::FastFeatureDetector::DetectorType type = cv::FastFeatureDetector::TYPE_9_16; // TYPE_9_16, TYPE_7_12, TYPE_5_8
-        detector = cv::FastFeatureDetector::create(threshold, bNMS, type);
+        return;
     }
+    LshIndex index(descRef.cols);
+    index.insert(descRef);
+    index.knnMatch(descSource, knnMatches, k);
+}
 
-    else if (detectorType.compare("BRISK") == 0)
+// k approximate nearest neighbours of float descriptors from an HNSW graph built over the reference descriptors
+static void knnMatchHnsw(const cv::Mat &descSource, const cv::Mat &descRef, vector<vector<cv::DMatch>> &knnMatches, int k)
+{
+    knnMatches.assign(descSource.rows, vector<cv::DMatch>());
+    if (descRef.empty())
     {
-        detector = cv::BRISK::create();
+        return;
     }
-    else if (detectorType.compare("ORB") == 0)
+    HnswIndex index(descRef.cols);
+    index.build(descRef);
+    index.knnMatch(descSource, knnMatches, k);
+}
+
+// Exhaustive nearest neighbours in both directions from one pass over the distance block. Source descriptors are
+// processed in blocks of 64 rows against every reference row; each block tracks the two smallest distances per
+// source row and the smallest distance per reference column, and the column minima of all blocks are reduced at the end
+template <typename Distance>
+static void mutualNearest(const cv::Mat &descSource, const cv::Mat &descRef, Distance distance, vector<float> &rowBest, vector<float> &rowSecond,
+                          vector<int> &rowIdx, vector<int> &colIdx)
+{
+    const int blockRows = 64;
+    int nSource = descSource.rows, nRef = descRef.rows;
+    int nBlocks = (nSource + blockRows - 1) / blockRows;
+    rowBest.assign(nSource, FLT_MAX);
+    rowSecond.assign(nSource, FLT_MAX);
+    rowIdx.assign(nSource, -1);
+    vector<float> blockColBest((size_t)nBlocks * nRef, FLT_MAX);
+    vector<int> blockColIdx((size_t)nBlocks * nRef, -1);
+
+    cv::parallel_for_(cv::Range(0, nBlocks), [&](const cv::Range &range) {
+        for (int b = range.start; b < range.end; ++b)
+        {
+            int rowEnd = min(nSource, (b + 1) * blockRows);
+            float *colBest = &blockColBest[(size_t)b * nRef];
+            int *colBestIdx = &blockColIdx[(size_t)b * nRef];
+            for (int j = 0; j < nRef; ++j)
+            {
+                const uchar *ref = descRef.ptr<uchar>(j);
+                for (int i = b * blockRows; i < rowEnd; ++i)
+                {
+                    float dist = distance(descSource.ptr<uchar>(i), ref);
+                    if (dist < rowBest[i])
+                    {
+                        rowSecond[i] = rowBest[i];
+                        rowBest[i] = dist;
+                        rowIdx[i] = j;
+                    }
+                    else if (dist < rowSecond[i])
+                    {
+                        rowSecond[i] = dist;
+                    }
+                    if (dist < colBest[j])
+                    {
+                        colBest[j] = dist;
+                        colBestIdx[j] = i;
+                    }
+                }
+            }
+        }
+    });
+
+    colIdx.assign(nRef, -1);
+    for (int j = 0; j < nRef; ++j)
     {
-        detector = cv::ORB::create();
+        float best = FLT_MAX;
+        for (int b = 0; b < nBlocks; ++b)
+        {
+            if (blockColBest[(size_t)b * nRef + j] < best)
+            {
+                best = blockColBest[(size_t)b * nRef + j];
+                colIdx[j] = blockColIdx[(size_t)b * nRef + j];
+            }
+        }
     }
-    else if (detectorType.compare("AKAZE") == 0)
+}
+
+// Keep only mutual nearest neighbours (cross check) at the cost of one matching direction, optionally combined
+// with the ratio test on the two nearest reference descriptors of every source descriptor
+static void matchMutualNN(cv::Mat &descSource, cv::Mat &descRef, vector<cv::DMatch> &matches, const string &descriptorType, double minDescDistRatio)
+{
+    if (descSource.empty() || descRef.empty())
     {
-        detector = cv::AKAZE::create();
+        return;
     }
-    else if (detectorType.compare("SIFT") == 0)
+
+    vector<float> rowBest, rowSecond;
+    vector<int> rowIdx, colIdx;
+    int cols = descRef.cols;
+    bool bHamming = descriptorType.compare("DES_BINARY") == 0;
+    if (bHamming)
     {
-        detector = cv::xfeatures2d::SIFT::create();
+        mutualNearest(descSource, descRef, [cols](const uchar *a, const uchar *b) { return (float)cv::hal::normHamming(a, b, cols); },
+                      rowBest, rowSecond, rowIdx, colIdx);
+    }
+    else if (descSource.type() == CV_8U && descRef.type() == CV_8U)
+    { // uint8 SIFT
+        mutualNearest(descSource, descRef, [cols](const uchar *a, const uchar *b) { return (float)normL2SqrU8(a, b, cols); },
+                      rowBest, rowSecond, rowIdx, colIdx);
     }
     else
     {
-        std::cout << "Invalid Keypoints Detector .\n";
+        if (descSource.type() != CV_32F)
+        {
+            descSource.convertTo(descSource, CV_32F);
+            descRef.convertTo(descRef, CV_32F);
+        }
+        mutualNearest(descSource, descRef, [cols](const uchar *a, const uchar *b) { return cv::hal::normL2Sqr_((const float *)a, (const float *)b, cols); },
+                      rowBest, rowSecond, rowIdx, colIdx);
     }
 
-    detector->detect(img, keypoints);
-    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
-    std::cout << detectorType <<" detection with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
-    
-    // visualize results
-    if (bVis)
+    // L2 distances are squared up to here, so is the ratio
+    double ratio = bHamming ? minDescDistRatio : minDescDistRatio * minDescDistRatio;
+    for (int i = 0; i < descSource.rows; ++i)
     {
-        cv::Mat visImage = img.clone();
-        cv::drawKeypoints(img, keypoints, visImage, cv::Scalar::all(-1), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
-        string windowName = detectorType + " Corner Detector Results";
-        cv::namedWindow(windowName, 6);
-        imshow(windowName, visImage);
-        cv::waitKey(0);
+        int j = rowIdx[i];
+        if (colIdx[j] != i)
+        {
+            continue;
+        }
+        if (minDescDistRatio > 0.0 && (rowSecond[i] == FLT_MAX || rowBest[i] >= ratio * rowSecond[i]))
+        {
+            continue;
+        }
+        matches.push_back(cv::DMatch(i, j, bHamming ? rowBest[i] : sqrt(rowBest[i])));
     }
-    return t;
-}
\ No newline at end of file
+}
+
+// Build the FLANN index over the descriptors of a frame. It is kept with the frame and serves as the train set
+// when the next frame is matched against it (see matchDescriptorsWithIndex), so every index is built once.
+double buildDescriptorIndex(DataFrame &frame, std::string descriptorType)
+{
+    frame.descriptorIndex.release();
+    if (frame.descriptors.rows < 2)
+    {
+        return 0.0;
+    }
+
+    double t = (double)cv::getTickCount();
+    cv::Mat desc = frame.descriptors;
+    if (descriptorType.compare("DES_BINARY") != 0 && desc.type() != CV_32F)
+    {
+        desc.convertTo(desc, CV_32F); // uint8 SIFT for the KD-tree, the frame keeps its compact descriptors
+    }
+    frame.descriptorIndex = createFlannMatcher(descriptorType);
+    frame.descriptorIndex->add(vector<cv::Mat>(1, desc));
+    frame.descriptorIndex->train();
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    cout << "FLANN index over n=" << desc.rows << " descriptors built in " << 1000 * t / 1.0 << " ms" << endl;
+    return t;
+}
+
+// Match the descriptors of the current frame against the index built over the previous frame. The current frame
+// is the query side here, so the resulting matches are swapped back to queryIdx = previous, trainIdx = current
+// keypoint, like the matches of matchDescriptors. With SEL_KNN, the ratio test is therefore applied to the
+// two nearest previous keypoints of every current keypoint.
+double matchDescriptorsWithIndex(DataFrame &framePrev, cv::Mat &descCurr, std::vector<cv::DMatch> &matches, std::string descriptorType, std::string selectorType)
+{
+    if (framePrev.descriptorIndex.empty() || descCurr.empty())
+    {
+        return 0.0;
+    }
+
+    double t = (double)cv::getTickCount();
+    cv::Mat desc = descCurr;
+    if (descriptorType.compare("DES_BINARY") != 0 && desc.type() != CV_32F)
+    {
+        desc.convertTo(desc, CV_32F);
+    }
+
+    vector<cv::DMatch> currMatches;
+    if (selectorType.compare("SEL_NN") == 0)
+    {
+        framePrev.descriptorIndex->match(desc, currMatches);
+    }
+    else if (selectorType.compare("SEL_KNN") == 0)
+    {
+        vector<vector<cv::DMatch>> knn_matches;
+        framePrev.descriptorIndex->knnMatch(desc, knn_matches, 2);
+        double minDescDistRatio = 0.8;
+        for (auto it = knn_matches.begin(); it != knn_matches.end(); ++it)
+        {
+            if (it->size() == 2 && (*it)[0].distance < minDescDistRatio * (*it)[1].distance)
+            {
+                currMatches.push_back((*it)[0]);
+            }
+        }
+    }
+    for (auto &match : currMatches)
+    {
+        matches.push_back(cv::DMatch(match.trainIdx, match.queryIdx, match.distance));
+    }
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    cout << "FLANN index matching with n=" << matches.size() << " matches in " << 1000 * t / 1.0 << " ms" << endl;
+    return t;
+}
+
+// Find best matches for keypoints in two camera images without logging. Returns the no. of source keypoints removed
+// by the ratio test or the mutual check, -1 for selectors which keep a match for every source keypoint.
+static int matchDescriptorsSilent(std::vector<cv::KeyPoint> &kPtsSource, std::vector<cv::KeyPoint> &kPtsRef, cv::Mat &descSource, cv::Mat &descRef,
+                                  std::vector<cv::DMatch> &matches, std::string descriptorType, std::string matcherType, std::string selectorType)
+{
+    if (selectorType.compare("SEL_MUTUAL") == 0 || selectorType.compare("SEL_MUTUAL_KNN") == 0)
+    { // mutual nearest neighbors from one exhaustive pass; SEL_MUTUAL_KNN adds the ratio test
+        // the pass is brute force, so only the exact matcher types can be combined with it
+        CV_Assert(matcherType.compare("MAT_BF") == 0 || matcherType.compare("MAT_HAMMING") == 0 || matcherType.compare("MAT_GEMM") == 0);
+        bool bKnn = selectorType.compare("SEL_MUTUAL_KNN") == 0;
+        matchMutualNN(descSource, descRef, matches, descriptorType, bKnn ? 0.8 : 0.0);
+        return descSource.rows - (int)matches.size();
+    }
+    else if (matcherType.compare("MAT_HAMMING") == 0)
+    { // binary descriptors : blocked popcount brute force matcher with the ratio test applied inline
+        bool bKnn = selectorType.compare("SEL_KNN") == 0;
+        matchHammingKnn(descSource, descRef, matches, bKnn ? 0.8 : 0.0);
+        return bKnn ? descSource.rows - (int)matches.size() : -1;
+    }
+    else if (matcherType.compare("MAT_GEMM") == 0)
+    { // float descriptors : blocked matrix multiply brute force matcher with the ratio test applied inline
+        CV_Assert(descriptorType.compare("DES_BINARY") != 0); // binary descriptors need the Hamming norm of MAT_HAMMING
+        if (descSource.type() != CV_32F)
+        { // uint8 SIFT is multiplied as floats
+            descSource.convertTo(descSource, CV_32F);
+            descRef.convertTo(descRef, CV_32F);
+        }
+        bool bKnn = selectorType.compare("SEL_KNN") == 0;
+        matchL2Gemm(descSource, descRef, matches, bKnn ? 0.8 : 0.0);
+        return bKnn ? descSource.rows - (int)matches.size() : -1;
+    }
+
+    // configure matcher
+    bool crossCheck = false;
+    cv::Ptr<cv::DescriptorMatcher> matcher;
+
+    if (matcherType.compare("MAT_BF") == 0)
+    {
+        // with SIFT (DES_HOG), normType = cv::NORM_L2; with all other DES_BINARY descriptors, normType = cv::NORM_HAMMING
+        int normType = descriptorType.compare("DES_BINARY") == 0 ? cv::NORM_HAMMING : cv::NORM_L2;
+        matcher = cv::BFMatcher::create(normType, crossCheck);
+    }
+    else if (matcherType.compare("MAT_FLANN") == 0)
+    {
+        // binary descriptors stay binary for the LSH index, only uint8 SIFT needs floats for the KD-tree
+        if (descriptorType.compare("DES_BINARY") != 0 && descSource.type() != CV_32F)
+        {
+            descSource.convertTo(descSource, CV_32F);
+            descRef.convertTo(descRef, CV_32F);
+        }
+        matcher = createFlannMatcher(descriptorType);
+    }
+    else if (matcherType.compare("MAT_HNSW") == 0)
+    {
+        // the graph is searched by L2 distance, binary descriptors need the Hamming norm of MAT_LSH
+        CV_Assert(descriptorType.compare("DES_BINARY") != 0);
+        if (descSource.type() != CV_32F)
+        { // uint8 SIFT is indexed as floats
+            descSource.convertTo(descSource, CV_32F);
+            descRef.convertTo(descRef, CV_32F);
+        }
+    }
+
+    // uint8 SIFT descriptors are brute force matched with the integer L2 kernel instead of cv::BFMatcher
+    bool bQuantized = matcherType.compare("MAT_BF") == 0 && descriptorType.compare("DES_HOG_U8") == 0;
+    // binary descriptors are searched in the multi-probe LSH index with MAT_LSH
+    bool bLsh = matcherType.compare("MAT_LSH") == 0;
+    // float descriptors are searched in the HNSW graph with MAT_HNSW
+    bool bHnsw = matcherType.compare("MAT_HNSW") == 0;
+    CV_Assert(matcher || bQuantized || bLsh || bHnsw); // unknown matcher type
+
+    // perform matching task
+    if (selectorType.compare("SEL_NN") == 0)
+    { // nearest neighbor (best match)
+
+        if (bQuantized || bLsh || bHnsw)
+        {
+            vector<vector<cv::DMatch>> nn_matches;
+            if (bQuantized)
+            {
+                knnMatchL2U8(descSource, descRef, nn_matches, 1);
+            }
+            else if (bLsh)
+            {
+                knnMatchLsh(descSource, descRef, nn_matches, 1);
+            }
+            else
+            {
+                knnMatchHnsw(descSource, descRef, nn_matches, 1);
+            }
+            for (auto &nn : nn_matches)
+            {
+                matches.insert(matches.end(), nn.begin(), nn.end());
+            }
+        }
+        else
+        {
+            matcher->match(descSource, descRef, matches); // Finds the best match for each descriptor in desc1
+        }
+    }
+    else if (selectorType.compare("SEL_KNN") == 0)
+    { // k nearest neighbors (k=2)
+        vector<vector<cv::DMatch>> knn_matches;
+        if (bQuantized)
+        {
+            knnMatchL2U8(descSource, descRef, knn_matches, 2);
+        }
+        else if (bLsh)
+        {
+            knnMatchLsh(descSource, descRef, knn_matches, 2);
+        }
+        else if (bHnsw)
+        {
+            knnMatchHnsw(descSource, descRef, knn_matches, 2);
+        }
+        else
+        {
+            matcher->knnMatch(descSource, descRef, knn_matches, 2); // find the 2 best matches
+        }
+        double minDescDistRatio = 0.8;
+        for (auto it = knn_matches.begin(); it != knn_matches.end(); ++it)
+        {
+            if (it->size() == 2 && (*it)[0].distance < minDescDistRatio * (*it)[1].distance)
+            {
+                matches.push_back((*it)[0]);
+            }
+        }
+        return (int)knn_matches.size() - (int)matches.size();
+    }
+    return -1;
+}
+
+// Find best matches for keypoints in two camera images based on several matching methods
+void matchDescriptors(std::vector<cv::KeyPoint> &kPtsSource, std::vector<cv::KeyPoint> &kPtsRef, cv::Mat &descSource, cv::Mat &descRef,
+                      std::vector<cv::DMatch> &matches, std::string descriptorType, std::string matcherType, std::string selectorType)
+{
+    int nRemoved = matchDescriptorsSilent(kPtsSource, kPtsRef, descSource, descRef, matches, descriptorType, matcherType, selectorType);
+    if (nRemoved >= 0)
+    {
+        cout << "# keypoints removed = " << nRemoved << endl;
+    }
+}
+
+// Use one of several types of state-of-art descriptors to uniquely identify keypoints
+double descKeypoints(vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &descriptors, string descriptorType)
+{
+    // select appropriate descriptor, built once and reused across frames
+    cv::Ptr<cv::DescriptorExtractor> extractor = getExtractor(descriptorType);
+
+    // perform feature description
+    double t = (double)cv::getTickCount();
+    extractor->compute(img, keypoints, descriptors);
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    cout << descriptorType << " descriptor extraction in " << 1000 * t / 1.0 << " ms" << endl;
+    return t;
+}
+
+// Compute descriptors on OpenCV's thread pool. Keypoints are ordered by image row and split into nPartitions
+// strips of equal count; each strip is described on its own crop of the image, padded by a margin which covers
+// the descriptor support of its largest keypoint. Every strip writes into its own row range of one preallocated
+// descriptor matrix, from which the descriptors are gathered in the original keypoint order, so the output is the
+// one of descKeypoints : the keypoints kept by the extractor in their input order, with descriptors in that order.
+// Only the patch-local extractors BRISK, BRIEF, BRIEF_SIMD, ORB and FREAK are parallelized. AKAZE and SIFT derive
+// their scale space (and AKAZE its contrast factor) from the whole image, which a crop would change, so they are
+// described serially with descKeypoints.
+// Note : the extractor is shared between strips. Its compute() must not modify the extractor, which does not hold
+// for the first call of FREAK (it builds its sampling pattern lazily), so every extractor is run once serially on
+// a single keypoint before it is first used from several threads.
+double descKeypointsParallel(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &descriptors, std::string descriptorType, int nPartitions)
+{
+    if (descriptorType.compare("AKAZE") == 0 || descriptorType.compare("SIFT") == 0)
+    {
+        return descKeypoints(keypoints, img, descriptors, descriptorType);
+    }
+
+    cv::Ptr<cv::DescriptorExtractor> extractor = getExtractor(descriptorType);
+    if (nPartitions <= 0)
+    {
+        nPartitions = cv::getNumThreads();
+    }
+    nPartitions = max(1, min(nPartitions, (int)keypoints.size()));
+
+    double t = (double)cv::getTickCount();
+    if (!keypoints.empty() && warmedUpExtractors.count(descriptorType) == 0)
+    { // initialize lazily built state of the shared extractor before concurrent compute() calls
+        vector<cv::KeyPoint> warmUpKeypoints(1, keypoints.front());
+        cv::Mat warmUpDescriptors;
+        extractor->compute(img, warmUpKeypoints, warmUpDescriptors);
+        warmedUpExtractors.insert(descriptorType);
+    }
+
+    // keypoint indices ordered by row; the caller's keypoints keep their order
+    int nKeypoints = (int)keypoints.size();
+    vector<int> order(nKeypoints);
+    for (int i = 0; i < nKeypoints; ++i)
+    {
+        order[i] = i;
+    }
+    stable_sort(order.begin(), order.end(), [&](int a, int b) { return keypoints[a].pt.y < keypoints[b].pt.y; });
+
+    cv::Mat allDescriptors(nKeypoints, extractor->descriptorSize(), extractor->descriptorType());
+    vector<cv::KeyPoint> describedKeypoints(nKeypoints);
+    vector<int> descriptorRow(nKeypoints, -1); // row in allDescriptors per keypoint index, -1 if dropped
+    vector<int> stripStart(nPartitions + 1);
+    for (int i = 0; i <= nPartitions; ++i)
+    {
+        stripStart[i] = (int)((long)nKeypoints * i / nPartitions);
+    }
+
+    cv::parallel_for_(cv::Range(0, nPartitions), [&](const cv::Range &range) {
+        for (int strip = range.start; strip < range.end; ++strip)
+        {
+            // the keypoint index travels in class_id, which the extractors keep for the keypoints they do not drop
+            vector<cv::KeyPoint> kpts;
+            for (int i = stripStart[strip]; i < stripStart[strip + 1]; ++i)
+            {
+                kpts.push_back(keypoints[order[i]]);
+                kpts.back().class_id = order[i];
+            }
+            if (kpts.empty())
+            {
+                continue;
+            }
+
+            // crop covering the strip, padded by the support radius of its largest keypoint
+            float yMin = kpts.front().pt.y, yMax = kpts.back().pt.y, maxSize = 0.f;
+            for (auto &kpt : kpts)
+            {
+                maxSize = max(maxSize, kpt.size);
+            }
+            int margin = max(48, (int)ceil(6.0 * maxSize));
+            int y0 = max(0, (int)floor(yMin) - margin), y1 = min(img.rows, (int)ceil(yMax) + margin + 1);
+            for (auto &kpt : kpts)
+            {
+                kpt.pt.y -= y0;
+            }
+
+            cv::Mat stripDescriptors;
+            extractor->compute(img.rowRange(y0, y1), kpts, stripDescriptors);
+            for (size_t i = 0; i < kpts.size(); ++i)
+            {
+                int idx = kpts[i].class_id;
+                int row = stripStart[strip] + (int)i;
+                stripDescriptors.row((int)i).copyTo(allDescriptors.row(row));
+                describedKeypoints[idx] = kpts[i];
+                describedKeypoints[idx].pt.y += y0;
+                describedKeypoints[idx].class_id = keypoints[idx].class_id;
+                descriptorRow[idx] = row;
+            }
+        }
+    });
+
+    // gather the described keypoints and their descriptors in the original order
+    vector<cv::KeyPoint> keptKeypoints;
+    cv::Mat keptDescriptors(nKeypoints, allDescriptors.cols, allDescriptors.type());
+    for (int idx = 0; idx < nKeypoints; ++idx)
+    {
+        if (descriptorRow[idx] >= 0)
+        {
+            allDescriptors.row(descriptorRow[idx]).copyTo(keptDescriptors.row((int)keptKeypoints.size()));
+            keptKeypoints.push_back(describedKeypoints[idx]);
+        }
+    }
+    keypoints = keptKeypoints;
+    descriptors = keptDescriptors.rowRange(0, (int)keypoints.size());
+
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    cout << descriptorType << " descriptor extraction in " << nPartitions << " strips (" << cv::getNumThreads() << " threads) in " << 1000 * t / 1.0 << " ms" << endl;
+    return t;
+}
+
+// Check whether detector and descriptor are the same algorithm, so that both stages can share one pass
+bool isFusedFeatureType(std::string detectorType, std::string descriptorType)
+{
+    if (detectorType.compare(descriptorType) != 0)
+    {
+        return false;
+    }
+    return detectorType.compare("SIFT") == 0 || detectorType.compare("ORB") == 0 ||
+           detectorType.compare("AKAZE") == 0 || detectorType.compare("BRISK") == 0;
+}
+
+// Detect keypoints and compute their descriptors in a single pass, which builds the scale space and
+// assigns orientations once instead of once per stage
+double detectAndDescribe(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &descriptors, std::string featureType)
+{
+    cv::Ptr<cv::Feature2D> engine = getDetector(featureType); // built once and reused across frames
+
+    double t = (double)cv::getTickCount();
+    engine->detectAndCompute(img, cv::noArray(), keypoints, descriptors);
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    cout << featureType << " detection and description with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
+    return t;
+}
+
+// Shi-Tomasi detector parameters
+static const int shiTomasiBlockSize = 4;        // size of an average block for computing a derivative covariation matrix over each pixel neighborhood
+static const int shiTomasiApertureSize = 3;     // aperture parameter for Sobel operator (must be odd)
+static const double shiTomasiMinDistance = 4.0; // min. distance between two features in pixels, i.e. no overlap of blocks
+
+// Locate Shi-Tomasi corners in a minimum eigenvalue image and append them to keypoints. The selection is the one of
+// cv::goodFeaturesToTrack : 3x3 local maxima above minEigenVal, accepted strongest first unless closer than
+// shiTomasiMinDistance to a corner accepted before. The minimum eigenvalue is kept as response.
+static void shiTomasiLocalMaxima(vector<cv::KeyPoint> &keypoints, const cv::Mat &eig, double minEigenVal)
+{
+    cv::Mat eigMax;
+    cv::dilate(eig, eigMax, cv::Mat());
+
+    vector<pair<float, int>> candidates; // eigenvalue, pixel offset
+    for (int j = 1; j < eig.rows - 1; j++)
+    {
+        const float *response = eig.ptr<float>(j);
+        const float *responseMax = eigMax.ptr<float>(j);
+        for (int i = 1; i < eig.cols - 1; i++)
+        {
+            if (response[i] > minEigenVal && response[i] == responseMax[i])
+            {
+                candidates.push_back(make_pair(response[i], j * eig.cols + i));
+            }
+        }
+    }
+    sort(candidates.begin(), candidates.end(), greater<pair<float, int>>());
+
+    // accepted corners are bucketed in a grid of shiTomasiMinDistance cells
+    int cellSize = cvRound(shiTomasiMinDistance);
+    int gridCols = (eig.cols + cellSize - 1) / cellSize;
+    int gridRows = (eig.rows + cellSize - 1) / cellSize;
+    vector<vector<cv::Point2f>> grid(gridCols * gridRows);
+    double minDistSq = shiTomasiMinDistance * shiTomasiMinDistance;
+
+    for (auto &candidate : candidates)
+    {
+        int j = candidate.second / eig.cols, i = candidate.second % eig.cols;
+        int cx = i / cellSize, cy = j / cellSize;
+        bool bOverlap = false;
+        for (int gy = max(0, cy - 1); gy <= min(gridRows - 1, cy + 1) && !bOverlap; gy++)
+        {
+            for (int gx = max(0, cx - 1); gx <= min(gridCols - 1, cx + 1) && !bOverlap; gx++)
+            {
+                for (auto &pt : grid[gy * gridCols + gx])
+                {
+                    if ((pt.x - i) * (pt.x - i) + (pt.y - j) * (pt.y - j) < minDistSq)
+                    {
+                        bOverlap = true;
+                        break;
+                    }
+                }
+            }
+        }
+        if (bOverlap)
+        {
+            continue;
+        }
+
+        cv::KeyPoint newKeyPoint;
+        newKeyPoint.pt = cv::Point2f(i, j);
+        newKeyPoint.size = shiTomasiBlockSize;
+        newKeyPoint.response = candidate.first;
+        grid[cy * gridCols + cx].push_back(newKeyPoint.pt);
+        keypoints.push_back(newKeyPoint);
+    }
+}
+
+// Detect Shi-Tomasi corners in img and append them to keypoints; qualityLevel is relative to the strongest corner
+static void shiTomasiCorners(vector<cv::KeyPoint> &keypoints, const cv::Mat &img, double qualityLevel = 0.01)
+{
+    cv::Mat eig;
+    cv::cornerMinEigenVal(img, eig, shiTomasiBlockSize, shiTomasiApertureSize);
+    double maxEigenVal;
+    cv::minMaxLoc(eig, nullptr, &maxEigenVal);
+    shiTomasiLocalMaxima(keypoints, eig, qualityLevel * maxEigenVal);
+}
+
+// Detect keypoints in image using the traditional Shi-Thomasi detector
+double detKeypointsShiTomasi(vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool bVis)
+{
+    double t = (double)cv::getTickCount();
+    shiTomasiCorners(keypoints, img);
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    cout << "Shi-Tomasi detection with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
+
+    // visualize results
+    if (bVis)
+    {
+        cv::Mat visImage = img.clone();
+        cv::drawKeypoints(img, keypoints, visImage, cv::Scalar::all(-1), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
+        string windowName = "Shi-Tomasi Corner Detector Results";
+        cv::namedWindow(windowName, 6);
+        imshow(windowName, visImage);
+        cv::waitKey(0);
+    }
+    return t;
+}
+
+// Harris detector parameters
+static const int harrisBlockSize = 4;    // for every pixel, a blockSize × blockSize neighborhood is considered
+static const int harrisApertureSize = 3; // aperture parameter for Sobel operator (must be odd)
+static const double harrisK = 0.04;      // Harris parameter (see equation for details)
+
+// Harris response of img, normalized to the 8bit range in which the Harris thresholds are given
+static void harrisResponse(const cv::Mat &img, cv::Mat &dst_norm)
+{
+    cv::Mat dst = cv::Mat::zeros(img.size(), CV_32FC1);
+    cv::cornerHarris(img, dst, harrisBlockSize, harrisApertureSize, harrisK, cv::BORDER_DEFAULT);
+    cv::normalize(dst, dst_norm, 0, 255, cv::NORM_MINMAX, CV_32FC1, cv::Mat());
+}
+
+// Locate Harris corners in a normalized Harris response image and append them to keypoints
+static void harrisLocalMaxima(vector<cv::KeyPoint> &keypoints, const cv::Mat &dst_norm, double minResponse)
+{
+    // Locate local maxima in the Harris response matrix 
+    // and perform a non-maximum suppression (NMS) in a local neighborhood around 
+    // each maximum. A pixel survives if it is above threshold and equals the maximum 
+    // of its neighbourhood, which a single dilation provides for the whole image.
+    // Two keypoints of size 2 * harrisApertureSize overlap when they are closer than that size,
+    // so the neighbourhood radius is chosen accordingly.
+    int nmsRadius = 2 * harrisApertureSize;
+    cv::Mat dst_max;
+    cv::dilate(dst_norm, dst_max, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2 * nmsRadius + 1, 2 * nmsRadius + 1)));
+
+    // pixels on a plateau of equal responses are all local maxima, so accepted keypoints are
+    // bucketed in a grid of nmsRadius cells and only the first one within nmsRadius is kept
+    int gridCols = dst_norm.cols / nmsRadius + 1;
+    int gridRows = dst_norm.rows / nmsRadius + 1;
+    vector<vector<int>> grid(gridCols * gridRows);
+
+    for (int j = 0; j < dst_norm.rows; j++)
+    {
+        const float *response = dst_norm.ptr<float>(j);
+        const float *responseMax = dst_max.ptr<float>(j);
+        for (int i = 0; i < dst_norm.cols; i++)
+        {
+            if (response[i] <= minResponse || response[i] < responseMax[i])
+            { // only store local maxima above a threshold
+                continue;
+            }
+
+            int cx = i / nmsRadius, cy = j / nmsRadius;
+            bool bOverlap = false;
+            for (int gy = max(0, cy - 1); gy <= min(gridRows - 1, cy + 1) && !bOverlap; gy++)
+            {
+                for (int gx = max(0, cx - 1); gx <= min(gridCols - 1, cx + 1) && !bOverlap; gx++)
+                {
+                    for (int idx : grid[gy * gridCols + gx])
+                    {
+                        const cv::Point2f &pt = keypoints[idx].pt;
+                        if ((pt.x - i) * (pt.x - i) + (pt.y - j) * (pt.y - j) < nmsRadius * nmsRadius)
+                        {
+                            bOverlap = true;
+                            break;
+                        }
+                    }
+                }
+            }
+            if (bOverlap)
+            {
+                continue;
+            }
+
+            cv::KeyPoint newKeyPoint;
+            newKeyPoint.pt = cv::Point2f(i, j);
+            newKeyPoint.size = 2 * harrisApertureSize;
+            newKeyPoint.response = response[i];
+            grid[cy * gridCols + cx].push_back((int)keypoints.size());
+            keypoints.push_back(newKeyPoint);
+
+        } // eof loop over cols
+    }
+}
+
+// Detect Harris corners in img and append them to keypoints
+static void harrisCorners(vector<cv::KeyPoint> &keypoints, const cv::Mat &img, double minResponse = 100)
+{
+    cv::Mat dst_norm;
+    harrisResponse(img, dst_norm);
+    harrisLocalMaxima(keypoints, dst_norm, minResponse);
+}
+
+double detKeypointsHarris(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, bool bVis)
+{
+    double t = (double)cv::getTickCount();
+    harrisCorners(keypoints, img);
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    cout << "Harris detection with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
+
+    // visualize results
+    if (bVis)
+    {
+        cv::Mat visImage = img.clone();
+        cv::drawKeypoints(img, keypoints, visImage, cv::Scalar::all(-1), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
+        string windowName = "Harris Corner Detector Results";
+        cv::namedWindow(windowName, 6);
+        imshow(windowName, visImage);
+        cv::waitKey(0);
+    }
+    return t;
+}
+
+// Return the grayscale view of a frame's camera image. It is converted on first request and kept as base level of
+// the frame pyramid, so every feature stage works on the same single-channel buffer instead of converting again.
+cv::Mat &getGrayImage(DataFrame &frame)
+{
+    if (frame.pyramid.levels.empty())
+    {
+        cv::Mat imgGray;
+        if (frame.cameraImg.channels() == 1)
+        {
+            imgGray = frame.cameraImg;
+        }
+        else
+        {
+            cv::cvtColor(frame.cameraImg, imgGray, cv::COLOR_BGR2GRAY);
+        }
+        frame.pyramid.levels.push_back(imgGray);
+    }
+    return frame.pyramid.levels[0];
+}
+
+// Return a level of the frame's Gaussian pyramid. levels[0] must hold the grayscale base image; all coarser
+// levels are built together on the first request for one of them. Levels keep a border of winSize pixels,
+// which lets pyramidal Lucas-Kanade consume them without building its own pyramid.
+cv::Mat &getPyramidLevel(ImagePyramid &pyramid, int level)
+{
+    CV_Assert(!pyramid.levels.empty());
+    if (level > 0 && (int)pyramid.levels.size() == 1)
+    {
+        vector<cv::Mat> levels;
+        pyramid.maxLevel = cv::buildOpticalFlowPyramid(pyramid.levels[0], levels, pyramid.winSize, pyramid.maxLevel, false);
+        pyramid.levels = levels;
+    }
+    CV_Assert(level < (int)pyramid.levels.size());
+    return pyramid.levels[level];
+}
+
+// thresholdGrid optionally holds FAST_SIMD thresholds per image region (see detectFastSimd), other types take none
+double detKeypointsModern(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, std::string detectorType, bool bVis, const cv::Mat &thresholdGrid)
+{   // Detect keypoints using modern detectors FAST, FAST_SIMD, BRISK, ORB, AKAZE, SIFT
+    bool bFastSimd = detectorType.compare("FAST_SIMD") == 0;
+    CV_Assert(bFastSimd || thresholdGrid.empty());
+    cv::Ptr<cv::FeatureDetector> detector;
+    if (!bFastSimd)
+    {
+        detector = getDetector(detectorType); // built once and reused across frames
+    }
+
+    double t = (double)cv::getTickCount();
+    if (bFastSimd)
+    {
+        detectFastSimd(keypoints, img, (int)defaultDetectorThreshold(detectorType), true, thresholdGrid);
+    }
+    else
+    {
+        detector->detect(img, keypoints);
+    }
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    std::cout << detectorType <<" detection with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
+    
+    // visualize results
+    if (bVis)
+    {
+        cv::Mat visImage = img.clone();
+        cv::drawKeypoints(img, keypoints, visImage, cv::Scalar::all(-1), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
+        string windowName = detectorType + " Corner Detector Results";
+        cv::namedWindow(windowName, 6);
+        imshow(windowName, visImage);
+        cv::waitKey(0);
+    }
+    return t;
+}
+
+// Detect keypoints of the given type in img without timing or visualization; threshold < 0 selects the default
+static void detectKeypoints(vector<cv::KeyPoint> &keypoints, const cv::Mat &img, const string &detectorType, double threshold = -1)
+{
+    if (threshold < 0)
+    {
+        threshold = defaultDetectorThreshold(detectorType);
+    }
+
+    if (detectorType.compare("SHITOMASI") == 0)
+    {
+        shiTomasiCorners(keypoints, img, threshold);
+    }
+    else if (detectorType.compare("HARRIS") == 0)
+    {
+        harrisCorners(keypoints, img, threshold);
+    }
+    else if (detectorType.compare("FAST_SIMD") == 0)
+    {
+        detectFastSimd(keypoints, img, (int)threshold);
+    }
+    else
+    {
+        getDetector(detectorType, threshold)->detect(img, keypoints);
+    }
+}
+
+// True for the corner detectors of our own, whose response is computed once for the full image and then searched
+// region by region, so that the thresholds relative to the strongest response refer to the full image
+static bool isCornerDetector(const string &detectorType)
+{
+    return detectorType.compare("SHITOMASI") == 0 || detectorType.compare("HARRIS") == 0;
+}
+
+// Corner response of the full image (8bit scaled for HARRIS, min. eigenvalue for SHITOMASI) and the minimum
+// response of a corner; threshold < 0 selects the default
+static void cornerResponse(cv::Mat &response, double &minResponse, const cv::Mat &img, const string &detectorType, double threshold = -1)
+{
+    if (threshold < 0)
+    {
+        threshold = defaultDetectorThreshold(detectorType);
+    }
+
+    if (detectorType.compare("SHITOMASI") == 0)
+    {
+        cv::cornerMinEigenVal(img, response, shiTomasiBlockSize, shiTomasiApertureSize);
+        double maxEigenVal;
+        cv::minMaxLoc(response, nullptr, &maxEigenVal);
+        minResponse = threshold * maxEigenVal;
+    }
+    else
+    {
+        harrisResponse(img, response);
+        minResponse = threshold;
+    }
+}
+
+// Locate corners in a region of a response from cornerResponse and append them to keypoints in region coordinates
+static void cornerLocalMaxima(vector<cv::KeyPoint> &keypoints, const cv::Mat &response, const string &detectorType, double minResponse)
+{
+    if (detectorType.compare("SHITOMASI") == 0)
+    {
+        shiTomasiLocalMaxima(keypoints, response, minResponse);
+    }
+    else
+    {
+        harrisLocalMaxima(keypoints, response, minResponse);
+    }
+}
+
+// Build the image regions in which keypoints are needed from the object bounding boxes. Each box is padded
+// to give detectors and descriptors some context, clipped to the image and overlapping regions are merged,
+// so that the returned regions are disjoint and every keypoint is found at most once.
+std::vector<cv::Rect> computeDetectionRois(std::vector<BoundingBox> &boundingBoxes, cv::Size imgSize, int padding)
+{
+    cv::Rect imgRect(0, 0, imgSize.width, imgSize.height);
+    vector<cv::Rect> rois;
+    for (auto &box : boundingBoxes)
+    {
+        cv::Rect roi(box.roi.x - padding, box.roi.y - padding, box.roi.width + 2 * padding, box.roi.height + 2 * padding);
+        roi &= imgRect;
+        if (roi.area() > 0)
+        {
+            rois.push_back(roi);
+        }
+    }
+
+    // merge overlapping regions until all of them are disjoint
+    bool bMerged = true;
+    while (bMerged)
+    {
+        bMerged = false;
+        for (size_t i = 0; i < rois.size() && !bMerged; ++i)
+        {
+            for (size_t j = i + 1; j < rois.size(); ++j)
+            {
+                if ((rois[i] & rois[j]).area() > 0)
+                {
+                    rois[i] |= rois[j];
+                    rois.erase(rois.begin() + j);
+                    bMerged = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // deterministic order from top-left to bottom-right
+    sort(rois.begin(), rois.end(), [](const cv::Rect &a, const cv::Rect &b) { return a.y != b.y ? a.y < b.y : a.x < b.x; });
+    return rois;
+}
+
+// Detect keypoints only inside the given disjoint image regions. Shi-Tomasi and Harris compute their response
+// and threshold on the full image as in detKeypointsTiled, so that the corners of a region do not depend on how
+// strong the other corners of that region are; only the search for local maxima is limited to the regions.
+double detKeypointsInRois(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, std::vector<cv::Rect> &rois, std::string detectorType)
+{
+    if (isRegistryDetector(detectorType))
+    {
+        getDetector(detectorType); // make sure construction is not part of the per-frame timing
+    }
+
+    double t = (double)cv::getTickCount();
+    cv::Mat response;
+    double minResponse = 0.0;
+    if (isCornerDetector(detectorType) && !rois.empty())
+    {
+        cornerResponse(response, minResponse, img, detectorType);
+    }
+
+    double roiArea = 0.0;
+    for (auto &roi : rois)
+    {
+        vector<cv::KeyPoint> roiKeypoints;
+        if (isCornerDetector(detectorType))
+        {
+            cornerLocalMaxima(roiKeypoints, response(roi), detectorType, minResponse);
+        }
+        else
+        {
+            detectKeypoints(roiKeypoints, img(roi), detectorType);
+        }
+
+        // shift keypoints from region into image coordinates
+        for (auto &kpt : roiKeypoints)
+        {
+            kpt.pt.x += roi.x;
+            kpt.pt.y += roi.y;
+            keypoints.push_back(kpt);
+        }
+        roiArea += roi.area();
+    }
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    cout << detectorType << " detection in " << rois.size() << " ROIs (" << 100.0 * roiArea / img.size().area() << "% of image) with n="
+         << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
+    return t;
+}
+
+// Compute descriptors region by region, so that extractors building image pyramids only process the regions.
+// Keypoints are expected to lie inside the disjoint regions (as returned by detKeypointsInRois); keypoints
+// dropped by the extractor are removed and the order of keypoints and descriptor rows is kept in sync.
+// Every region is described on a crop which is padded by the context the extractor samples around its keypoints,
+// so that the extractor only drops the keypoints it would also drop on the full image.
+double descKeypointsInRois(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, cv::Mat &descriptors, std::vector<cv::Rect> &rois, std::string descriptorType)
+{
+    cv::Ptr<cv::DescriptorExtractor> extractor = getExtractor(descriptorType);
+
+    double t = (double)cv::getTickCount();
+
+    // assign each keypoint to the region which contains it
+    vector<vector<cv::KeyPoint>> roiKeypoints(rois.size());
+    for (auto &kpt : keypoints)
+    {
+        for (size_t i = 0; i < rois.size(); ++i)
+        {
+            if (rois[i].contains(kpt.pt))
+            {
+                cv::KeyPoint roiKpt = kpt;
+                roiKpt.pt.x -= rois[i].x;
+                roiKpt.pt.y -= rois[i].y;
+                roiKeypoints[i].push_back(roiKpt);
+                break;
+            }
+        }
+    }
+
+    vector<cv::KeyPoint> describedKeypoints;
+    descriptors.release();
+    cv::Rect imgRect(0, 0, img.cols, img.rows);
+    for (size_t i = 0; i < rois.size(); ++i)
+    {
+        if (roiKeypoints[i].empty())
+        {
+            continue;
+        }
+
+        // context : the 31 px patch of ORB (which covers the 28 px border of BRIEF) plus three keypoint diameters
+        // for the scale dependent sampling patterns of BRISK, FREAK, AKAZE and SIFT
+        float maxSize = 0.f;
+        for (auto &kpt : roiKeypoints[i])
+        {
+            maxSize = max(maxSize, kpt.size);
+        }
+        int margin = 32 + (int)ceil(3 * maxSize);
+        cv::Rect crop = cv::Rect(rois[i].x - margin, rois[i].y - margin, rois[i].width + 2 * margin, rois[i].height + 2 * margin) & imgRect;
+        for (auto &kpt : roiKeypoints[i])
+        {
+            kpt.pt.x += rois[i].x - crop.x;
+            kpt.pt.y += rois[i].y - crop.y;
+        }
+
+        cv::Mat roiDescriptors;
+        extractor->compute(img(crop), roiKeypoints[i], roiDescriptors);
+        for (auto &kpt : roiKeypoints[i])
+        {
+            kpt.pt.x += crop.x;
+            kpt.pt.y += crop.y;
+            describedKeypoints.push_back(kpt);
+        }
+        descriptors.push_back(roiDescriptors);
+    }
+    keypoints = describedKeypoints;
+
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    cout << descriptorType << " descriptor extraction in " << rois.size() << " ROIs in " << 1000 * t / 1.0 << " ms" << endl;
+    return t;
+}
+
+// Detect keypoints tile by tile on OpenCV's thread pool. The image is split into tilesX x tilesY core tiles,
+// each of which is processed with `overlap` pixels of context on every side so that detector borders and
+// non-maximum suppression at the seams see the same neighbourhood as on the full image. A keypoint is kept only
+// by the tile whose core contains it, which removes the duplicates found in the overlap of neighbouring tiles.
+// Optionally, the merged result is capped to the maxKeypoints strongest responses.
+// Shi-Tomasi and Harris compute their response and threshold once on the full image and only search the tiles
+// for local maxima, so that a tile without strong corners does not lower the threshold for its weak ones.
+// Note : one detector from the registry is shared by all tiles. FAST, BRISK, ORB, AKAZE and SIFT keep all
+// per-call state local to detect() and only read their parameters (and BRISK its sampling pattern) from the
+// engine, so concurrent calls are safe; FAST_SIMD, Shi-Tomasi and Harris are stateless functions.
+double detKeypointsTiled(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, std::string detectorType, int tilesX, int tilesY, int overlap, int maxKeypoints)
+{
+    if (isRegistryDetector(detectorType))
+    {
+        getDetector(detectorType); // build the shared detector before the tiles access the registry concurrently
+    }
+
+    double t = (double)cv::getTickCount();
+    cv::Mat response;
+    double minResponse = 0.0;
+    if (isCornerDetector(detectorType))
+    {
+        cornerResponse(response, minResponse, img, detectorType);
+    }
+    cv::Rect imgRect(0, 0, img.cols, img.rows);
+    int nTiles = tilesX * tilesY;
+    vector<vector<cv::KeyPoint>> tileKeypoints(nTiles);
+
+    cv::parallel_for_(cv::Range(0, nTiles), [&](const cv::Range &range) {
+        for (int tile = range.start; tile < range.end; ++tile)
+        {
+            int tx = tile % tilesX, ty = tile / tilesX;
+            int x0 = img.cols * tx / tilesX, x1 = img.cols * (tx + 1) / tilesX;
+            int y0 = img.rows * ty / tilesY, y1 = img.rows * (ty + 1) / tilesY;
+            cv::Rect core(x0, y0, x1 - x0, y1 - y0);
+            cv::Rect tileRect = cv::Rect(x0 - overlap, y0 - overlap, core.width + 2 * overlap, core.height + 2 * overlap) & imgRect;
+
+            vector<cv::KeyPoint> detected;
+            if (isCornerDetector(detectorType))
+            {
+                cornerLocalMaxima(detected, response(tileRect), detectorType, minResponse);
+            }
+            else
+            {
+                detectKeypoints(detected, img(tileRect), detectorType);
+            }
+            for (auto &kpt : detected)
+            {
+                kpt.pt.x += tileRect.x;
+                kpt.pt.y += tileRect.y;
+                if (core.contains(kpt.pt))
+                {
+                    tileKeypoints[tile].push_back(kpt);
+                }
+            }
+        }
+    });
+
+    // merge in tile order, so that the result does not depend on thread scheduling
+    for (auto &tkpts : tileKeypoints)
+    {
+        keypoints.insert(keypoints.end(), tkpts.begin(), tkpts.end());
+    }
+    if (maxKeypoints > 0 && (int)keypoints.size() > maxKeypoints)
+    {
+        cv::KeyPointsFilter::retainBest(keypoints, maxKeypoints);
+    }
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    cout << detectorType << " tiled detection (" << tilesX << "x" << tilesY << " tiles) with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
+    return t;
+}
+
+// Reduce keypoints to at most maxKeypoints while keeping them spread over the image. Every cell of a
+// gridCols x gridRows grid first keeps its strongest keypoints up to an equal share of the budget,
+// the remaining budget is then filled with the strongest of all leftover keypoints.
+void retainBestBucketed(std::vector<cv::KeyPoint> &keypoints, int maxKeypoints, cv::Size imgSize, int gridCols, int gridRows)
+{
+    if ((int)keypoints.size() <= maxKeypoints)
+    {
+        return;
+    }
+
+    int nCells = gridCols * gridRows;
+    vector<vector<cv::KeyPoint>> cells(nCells);
+    for (auto &kpt : keypoints)
+    {
+        int cx = min(gridCols - 1, max(0, (int)(kpt.pt.x * gridCols / imgSize.width)));
+        int cy = min(gridRows - 1, max(0, (int)(kpt.pt.y * gridRows / imgSize.height)));
+        cells[cy * gridCols + cx].push_back(kpt);
+    }
+
+    auto byResponse = [](const cv::KeyPoint &a, const cv::KeyPoint &b) { return a.response > b.response; };
+    int cellQuota = maxKeypoints / nCells;
+    vector<cv::KeyPoint> retained, leftover;
+    for (auto &cell : cells)
+    {
+        size_t nKeep = min(cell.size(), (size_t)cellQuota);
+        partial_sort(cell.begin(), cell.begin() + nKeep, cell.end(), byResponse);
+        retained.insert(retained.end(), cell.begin(), cell.begin() + nKeep);
+        leftover.insert(leftover.end(), cell.begin() + nKeep, cell.end());
+    }
+
+    size_t nFill = min(leftover.size(), (size_t)(maxKeypoints - (int)retained.size()));
+    partial_sort(leftover.begin(), leftover.begin() + nFill, leftover.end(), byResponse);
+    retained.insert(retained.end(), leftover.begin(), leftover.begin() + nFill);
+    keypoints = retained;
+}
+
+// Detect keypoints with the threshold held by the budget controller and adapt that threshold for the next
+// frame, so that the keypoint count converges to the target and downstream matching and TTC cost stays bounded.
+// The detector threshold is moved in steps of 1/8 octave (in log scale) around its default value and clamped
+// to [default / 16, default * 16], which keeps the number of distinct detectors in the registry small.
+// Surplus keypoints of the current frame are removed with a spatially balanced selection.
+double detKeypointsBudget(std::vector<cv::KeyPoint> &keypoints, cv::Mat &img, std::string detectorType, KeypointBudget &budget, bool bVis)
+{
+    double defaultThreshold = defaultDetectorThreshold(detectorType);
+    budget.logStep = min(32, max(-32, budget.logStep));
+    budget.threshold = defaultThreshold * pow(2.0, budget.logStep / 8.0);
+    if (isRegistryDetector(detectorType))
+    {
+        getDetector(detectorType, budget.threshold); // keep construction out of the per-frame timing
+    }
+
+    double t = (double)cv::getTickCount();
+    detectKeypoints(keypoints, img, detectorType, budget.threshold);
+    int nDetected = (int)keypoints.size();
+    retainBestBucketed(keypoints, budget.targetKeypoints, img.size(), budget.gridCols, budget.gridRows);
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    cout << detectorType << " detection (threshold " << budget.threshold << ") with n=" << nDetected << " keypoints, "
+         << keypoints.size() << " kept in " << 1000 * t / 1.0 << " ms" << endl;
+
+    // adapt threshold for the next frame : a count above target raises the threshold and vice versa,
+    // with a proportional step in log scale and a dead band of +/- 10% around the target
+    if (nDetected > 0)
+    {
+        double ratio = (double)nDetected / budget.targetKeypoints;
+        if (ratio > 1.1 || ratio < 0.9)
+        {
+            int step = (int)round(8.0 * budget.gain * log2(ratio));
+            budget.logStep += step != 0 ? step : (ratio > 1.0 ? 1 : -1);
+        }
+    }
+    else
+    {
+        budget.logStep -= 8; // nothing found, lower the threshold by one octave
+    }
+
+    // visualize results
+    if (bVis)
+    {
+        cv::Mat visImage = img.clone();
+        cv::drawKeypoints(img, keypoints, visImage, cv::Scalar::all(-1), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
+        string windowName = detectorType + " Budgeted Detector Results";
+        cv::namedWindow(windowName, 6);
+        imshow(windowName, visImage);
+        cv::waitKey(0);
+    }
+    return t;
+}
+
+// Track the keypoints of the previous frame into the current frame with pyramidal Lucas-Kanade on the cached frame
+// pyramids. Tracks which fail, leave the image or do not return to their start point when tracked backwards are
+// dropped; the survivors become the first keypoints of the current frame and are returned as matches with
+// queryIdx in the previous and trainIdx in the current frame, just like matchDescriptors. When too few tracks
+// survive or the replenishment interval has passed, newly detected keypoints away from the tracks are appended.
+double trackKeypointsKLT(std::vector<cv::KeyPoint> &kptsPrev, ImagePyramid &pyramidPrev, std::vector<cv::KeyPoint> &kptsCurr, ImagePyramid &pyramidCurr,
+                         std::vector<cv::DMatch> &matches, std::string detectorType, KltTracking &tracking)
+{
+    // build all levels up front, so that Lucas-Kanade uses the cached pyramids instead of building its own
+    getPyramidLevel(pyramidPrev, 1);
+    getPyramidLevel(pyramidCurr, 1);
+    int maxLevel = min(pyramidPrev.maxLevel, pyramidCurr.maxLevel);
+    cv::Size imgSize = pyramidCurr.levels[0].size();
+
+    double t = (double)cv::getTickCount();
+    vector<cv::Point2f> ptsPrev, ptsCurr, ptsBack;
+    cv::KeyPoint::convert(kptsPrev, ptsPrev);
+    kptsCurr.clear();
+    matches.clear();
+    if (!ptsPrev.empty())
+    {
+        vector<uchar> status, statusBack;
+        vector<float> err;
+        cv::TermCriteria criteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, 30, 0.01);
+        cv::calcOpticalFlowPyrLK(pyramidPrev.levels, pyramidCurr.levels, ptsPrev, ptsCurr, status, err, pyramidCurr.winSize, maxLevel, criteria);
+        ptsBack = ptsPrev; // initial guess for the backward pass
+        cv::calcOpticalFlowPyrLK(pyramidCurr.levels, pyramidPrev.levels, ptsCurr, ptsBack, statusBack, err, pyramidCurr.winSize, maxLevel,
+                                 criteria, cv::OPTFLOW_USE_INITIAL_FLOW);
+
+        cv::Rect_<float> imgRect(0.f, 0.f, (float)imgSize.width - 1.f, (float)imgSize.height - 1.f);
+        for (size_t i = 0; i < ptsPrev.size(); ++i)
+        {
+            if (!status[i] || !statusBack[i] || !imgRect.contains(ptsCurr[i]) || cv::norm(ptsBack[i] - ptsPrev[i]) > tracking.maxFbError)
+            {
+                continue;
+            }
+            cv::KeyPoint kpt = kptsPrev[i];
+            kpt.pt = ptsCurr[i];
+            matches.push_back(cv::DMatch((int)i, (int)kptsCurr.size(), 0.f));
+            kptsCurr.push_back(kpt);
+        }
+    }
+    int nTracked = (int)kptsCurr.size();
+
+    // replenish keypoints which are not too close to a surviving track
+    tracking.framesSinceDetection++;
+    if (nTracked < tracking.minTracks || tracking.framesSinceDetection >= tracking.redetectInterval)
+    {
+        cv::Mat occupied = cv::Mat::zeros(imgSize, CV_8UC1);
+        for (auto &kpt : kptsCurr)
+        {
+            cv::circle(occupied, kpt.pt, tracking.minDistance, cv::Scalar(255), -1);
+        }
+        vector<cv::KeyPoint> kptsNew;
+        detectKeypoints(kptsNew, pyramidCurr.levels[0], detectorType);
+        for (auto &kpt : kptsNew)
+        {
+            int x = min(imgSize.width - 1, cvRound(kpt.pt.x)), y = min(imgSize.height - 1, cvRound(kpt.pt.y));
+            if (!occupied.at<uchar>(y, x))
+            {
+                kptsCurr.push_back(kpt);
+            }
+        }
+        tracking.framesSinceDetection = 0;
+    }
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    cout << "KLT tracking of n=" << kptsPrev.size() << " keypoints with " << nTracked << " tracks, " << kptsCurr.size() - nTracked
+         << " keypoints replenished by " << detectorType << " in " << 1000 * t / 1.0 << " ms" << endl;
+    return t;
+}
+
+// Predict the image motion of every keypoint of framePrev for the next frame from the last frame pair
+// (constant velocity) : a keypoint inside a bounding box moves with the median flow of the matches of the smallest
+// such box, all other keypoints are assumed static. kptsPrevPrev are the keypoints referenced by the queryIdx
+// of framePrev.kptMatches.
+void predictKeypointFlow(std::vector<cv::KeyPoint> &kptsPrevPrev, DataFrame &framePrev, std::vector<cv::Point2f> &flow)
+{
+    vector<cv::KeyPoint> &kpts = framePrev.keypoints;
+    vector<BoundingBox> &boxes = framePrev.boundingBoxes;
+
+    // smallest box containing each keypoint
+    vector<int> kptBox(kpts.size(), -1);
+    for (size_t k = 0; k < kpts.size(); ++k)
+    {
+        for (size_t b = 0; b < boxes.size(); ++b)
+        {
+            if (boxes[b].roi.contains(kpts[k].pt) && (kptBox[k] < 0 || boxes[b].roi.area() < boxes[kptBox[k]].roi.area()))
+            {
+                kptBox[k] = (int)b;
+            }
+        }
+    }
+
+    // median flow per box over the matches ending inside it
+    vector<vector<float>> flowX(boxes.size()), flowY(boxes.size());
+    for (auto &match : framePrev.kptMatches)
+    {
+        int b = kptBox[match.trainIdx];
+        if (b >= 0)
+        {
+            flowX[b].push_back(kpts[match.trainIdx].pt.x - kptsPrevPrev[match.queryIdx].pt.x);
+            flowY[b].push_back(kpts[match.trainIdx].pt.y - kptsPrevPrev[match.queryIdx].pt.y);
+        }
+    }
+    vector<cv::Point2f> boxFlow(boxes.size(), cv::Point2f(0.f, 0.f));
+    for (size_t b = 0; b < boxes.size(); ++b)
+    {
+        if (!flowX[b].empty())
+        {
+            size_t mid = flowX[b].size() / 2;
+            nth_element(flowX[b].begin(), flowX[b].begin() + mid, flowX[b].end());
+            nth_element(flowY[b].begin(), flowY[b].begin() + mid, flowY[b].end());
+            boxFlow[b] = cv::Point2f(flowX[b][mid], flowY[b][mid]);
+        }
+    }
+
+    flow.assign(kpts.size(), cv::Point2f(0.f, 0.f));
+    for (size_t k = 0; k < kpts.size(); ++k)
+    {
+        if (kptBox[k] >= 0)
+        {
+            flow[k] = boxFlow[kptBox[k]];
+        }
+    }
+}
+
+// Match descriptors only against reference keypoints within searchRadius pixels of the predicted position of the
+// source keypoint (its position plus flow, or its position if flow is empty). Reference keypoints are bucketed
+// into a uniform grid of searchRadius sized cells stored as flat arrays, so each source keypoint only visits the
+// 3x3 cells around its prediction. Distances follow descriptorType (Hamming for DES_BINARY, L2 otherwise);
+// SEL_NN keeps the nearest candidate and SEL_KNN applies the 0.8 ratio test to the two nearest candidates.
+double matchDescriptorsWindowed(std::vector<cv::KeyPoint> &kPtsSource, std::vector<cv::KeyPoint> &kPtsRef, cv::Mat &descSource, cv::Mat &descRef,
+                                std::vector<cv::DMatch> &matches, std::string descriptorType, std::string selectorType,
+                                float searchRadius, std::vector<cv::Point2f> &flow)
+{
+    double t = (double)cv::getTickCount();
+    bool bHamming = descriptorType.compare("DES_BINARY") == 0;
+    bool bKnn = selectorType.compare("SEL_KNN") == 0;
+    CV_Assert(descSource.cols == descRef.cols && descSource.type() == descRef.type());
+    CV_Assert(bHamming || descSource.type() == CV_32F || descriptorType.compare("DES_HOG_U8") == 0);
+
+    // bucket the reference keypoints : cellStart[c] .. cellStart[c + 1] index into cellKeypoints
+    float cellSize = max(1.f, searchRadius);
+    float maxX = 0.f, maxY = 0.f;
+    for (auto &kpt : kPtsRef)
+    {
+        maxX = max(maxX, kpt.pt.x);
+        maxY = max(maxY, kpt.pt.y);
+    }
+    int gridCols = (int)(maxX / cellSize) + 1, gridRows = (int)(maxY / cellSize) + 1;
+    auto cellOf = [&](const cv::Point2f &pt) {
+        int cx = min(gridCols - 1, max(0, (int)(pt.x / cellSize)));
+        int cy = min(gridRows - 1, max(0, (int)(pt.y / cellSize)));
+        return cy * gridCols + cx;
+    };
+    vector<int> cellStart(gridCols * gridRows + 1, 0), cellKeypoints(kPtsRef.size());
+    for (auto &kpt : kPtsRef)
+    {
+        cellStart[cellOf(kpt.pt) + 1]++;
+    }
+    partial_sum(cellStart.begin(), cellStart.end(), cellStart.begin());
+    vector<int> cellFill(cellStart.begin(), cellStart.end() - 1);
+    for (size_t j = 0; j < kPtsRef.size(); ++j)
+    {
+        cellKeypoints[cellFill[cellOf(kPtsRef[j].pt)]++] = (int)j;
+    }
+
+    // descriptor distance in the unit of the matching norm
+    auto distance = [&](int i, int j) -> float {
+        if (bHamming)
+        {
+            return (float)cv::hal::normHamming(descSource.ptr<uchar>(i), descRef.ptr<uchar>(j), descSource.cols);
+        }
+        else if (descSource.type() == CV_32F)
+        {
+            return sqrt(cv::hal::normL2Sqr_(descSource.ptr<float>(i), descRef.ptr<float>(j), descSource.cols));
+        }
+        return sqrt((float)normL2SqrU8(descSource.ptr<uchar>(i), descRef.ptr<uchar>(j), descSource.cols));
+    };
+
+    int nSource = (int)kPtsSource.size();
+    vector<cv::DMatch> best(nSource);
+    vector<uchar> bValid(nSource, 0);
+    float radiusSqr = searchRadius * searchRadius;
+    cv::parallel_for_(cv::Range(0, nSource), [&](const cv::Range &range) {
+        for (int i = range.start; i < range.end; ++i)
+        {
+            cv::Point2f predicted = kPtsSource[i].pt + (flow.empty() ? cv::Point2f(0.f, 0.f) : flow[i]);
+            int cx = (int)floor(predicted.x / cellSize), cy = (int)floor(predicted.y / cellSize);
+            float b1 = numeric_limits<float>::max(), b2 = numeric_limits<float>::max();
+            int bi = -1;
+            for (int y = max(0, cy - 1); y <= min(gridRows - 1, cy + 1); ++y)
+            {
+                for (int x = max(0, cx - 1); x <= min(gridCols - 1, cx + 1); ++x)
+                {
+                    int cell = y * gridCols + x;
+                    for (int c = cellStart[cell]; c < cellStart[cell + 1]; ++c)
+                    {
+                        int j = cellKeypoints[c];
+                        cv::Point2f diff = kPtsRef[j].pt - predicted;
+                        if (diff.x * diff.x + diff.y * diff.y > radiusSqr)
+                        {
+                            continue;
+                        }
+                        float dist = distance(i, j);
+                        if (dist < b2)
+                        {
+                            if (dist < b1)
+                            {
+                                b2 = b1;
+                                b1 = dist;
+                                bi = j;
+                            }
+                            else
+                            {
+                                b2 = dist;
+                            }
+                        }
+                    }
+                }
+            }
+            if (bi >= 0 && (!bKnn || (b2 != numeric_limits<float>::max() && b1 < 0.8f * b2)))
+            {
+                best[i] = cv::DMatch(i, bi, b1);
+                bValid[i] = 1;
+            }
+        }
+    });
+
+    for (int i = 0; i < nSource; ++i)
+    {
+        if (bValid[i])
+        {
+            matches.push_back(best[i]);
+        }
+    }
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    cout << "Windowed matching (radius " << searchRadius << " px) with n=" << matches.size() << " matches in " << 1000 * t / 1.0 << " ms" << endl;
+    return t;
+}
+
+// Match descriptors box pair by box pair instead of over the whole frame. Each bounding box of framePrev is moved
+// by its last track displacement (from the box of boxesPrevPrev it was associated with in framePrev.bbMatches,
+// zero if it has no track) and paired with every box of frameCurr overlapping the predicted region. For each pair,
+// the matcher only sees the descriptor rows of the keypoints inside both boxes; one summary is logged per frame. A previous keypoint which
+// lies in several boxes keeps its best match over all pairs; matches are ordered by previous keypoint index.
+double matchDescriptorsInBoxPairs(std::vector<BoundingBox> &boxesPrevPrev, DataFrame &framePrev, DataFrame &frameCurr, std::vector<cv::DMatch> &matches,
+                                  std::string descriptorType, std::string matcherType, std::string selectorType)
+{
+    double t = (double)cv::getTickCount();
+
+    // keypoints inside each box, with their descriptor rows gathered once per box
+    auto gatherBoxRows = [](vector<BoundingBox> &boxes, vector<cv::KeyPoint> &kpts, cv::Mat &desc, vector<vector<int>> &indices,
+                            vector<vector<cv::KeyPoint>> &boxKpts, vector<cv::Mat> &boxDesc) {
+        indices.assign(boxes.size(), vector<int>());
+        boxKpts.assign(boxes.size(), vector<cv::KeyPoint>());
+        boxDesc.assign(boxes.size(), cv::Mat());
+        for (size_t b = 0; b < boxes.size(); ++b)
+        {
+            for (size_t k = 0; k < kpts.size(); ++k)
+            {
+                if (boxes[b].roi.contains(kpts[k].pt))
+                {
+                    indices[b].push_back((int)k);
+                    boxKpts[b].push_back(kpts[k]);
+                    boxDesc[b].push_back(desc.row((int)k));
+                }
+            }
+        }
+    };
+    vector<vector<int>> indicesPrev, indicesCurr;
+    vector<vector<cv::KeyPoint>> kptsPrev, kptsCurr;
+    vector<cv::Mat> descPrev, descCurr;
+    gatherBoxRows(framePrev.boundingBoxes, framePrev.keypoints, framePrev.descriptors, indicesPrev, kptsPrev, descPrev);
+    gatherBoxRows(frameCurr.boundingBoxes, frameCurr.keypoints, frameCurr.descriptors, indicesCurr, kptsCurr, descCurr);
+
+    // displacement of each previous box over its last track
+    map<int, cv::Point> boxShift;
+    for (auto &bbMatch : framePrev.bbMatches)
+    {
+        for (auto &boxFrom : boxesPrevPrev)
+        {
+            for (auto &boxTo : framePrev.boundingBoxes)
+            {
+                if (boxFrom.boxID == bbMatch.first && boxTo.boxID == bbMatch.second)
+                {
+                    boxShift[boxTo.boxID] = (boxTo.roi.tl() + boxTo.roi.br() - boxFrom.roi.tl() - boxFrom.roi.br()) / 2;
+                }
+            }
+        }
+    }
+
+    map<int, cv::DMatch> bestMatches; // previous keypoint index -> best match over all box pairs
+    int nPairs = 0, nRemoved = 0;
+    for (size_t bp = 0; bp < framePrev.boundingBoxes.size(); ++bp)
+    {
+        BoundingBox &boxPrev = framePrev.boundingBoxes[bp];
+        cv::Rect predicted = boxPrev.roi + (boxShift.count(boxPrev.boxID) ? boxShift[boxPrev.boxID] : cv::Point(0, 0));
+        for (size_t bc = 0; bc < frameCurr.boundingBoxes.size(); ++bc)
+        {
+            if ((predicted & frameCurr.boundingBoxes[bc].roi).area() <= 0 || descPrev[bp].rows < 2 || descCurr[bc].rows < 2)
+            {
+                continue;
+            }
+
+            vector<cv::DMatch> pairMatches;
+            cv::Mat pairDescPrev = descPrev[bp], pairDescCurr = descCurr[bc]; // the FLANN path may convert them in place
+            nRemoved += max(0, matchDescriptorsSilent(kptsPrev[bp], kptsCurr[bc], pairDescPrev, pairDescCurr, pairMatches, descriptorType, matcherType, selectorType));
+            for (auto &match : pairMatches)
+            {
+                cv::DMatch frameMatch(indicesPrev[bp][match.queryIdx], indicesCurr[bc][match.trainIdx], match.distance);
+                auto it = bestMatches.find(frameMatch.queryIdx);
+                if (it == bestMatches.end() || frameMatch.distance < it->second.distance)
+                {
+                    bestMatches[frameMatch.queryIdx] = frameMatch;
+                }
+            }
+            nPairs++;
+        }
+    }
+
+    for (auto &bestMatch : bestMatches)
+    {
+        matches.push_back(bestMatch.second);
+    }
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    cout << "Box pair matching over " << nPairs << " box pairs with n=" << matches.size() << " matches (" << nRemoved
+         << " removed by the selector) in " << 1000 * t / 1.0 << " ms" << endl;
+    return t;
+}
@@ -0,0 +1,541 @@
+#include <iostream>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <cstdint>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "simdFeatures.hpp"
+
+using namespace std;
+
+// Bresenham circle of radius 3 around the candidate pixel as (dx, dy), in the same order as OpenCV's FAST
+static const int fastCircle[16][2] = {{0, 3}, {1, 3}, {2, 2}, {3, 1}, {3, 0}, {3, -1}, {2, -2}, {1, -3},
+                                      {0, -3}, {-1, -3}, {-2, -2}, {-3, -1}, {-3, 0}, {-3, 1}, {-2, 2}, {-1, 3}};
+
+// Corner score : the largest threshold for which the pixel still passes the 9-of-16 segment test, minus one
+static int fastScore(const uchar *ptr, const int *offsets)
+{
+    int center = ptr[0];
+    int d[16];
+    for (int k = 0; k < 16; k++)
+    {
+        d[k] = center - ptr[offsets[k]]; // > 0 : circle pixel is darker than the center
+    }
+
+    int best = 0;
+    for (int start = 0; start < 16; start++)
+    {
+        int minDarker = 255, minBrighter = 255;
+        for (int i = 0; i < 9; i++)
+        {
+            int v = d[(start + i) & 15];
+            minDarker = min(minDarker, v);
+            minBrighter = min(minBrighter, -v);
+        }
+        best = max(best, max(minDarker, minBrighter));
+    }
+    return best - 1;
+}
+
+// Scalar 9-of-16 segment test : at least 9 contiguous circle pixels brighter than center + t or darker than center - t
+static bool fastSegmentTest(const uchar *ptr, const int *offsets, int threshold)
+{
+    int upper = ptr[0] + threshold, lower = ptr[0] - threshold;
+    int runBrighter = 0, runDarker = 0;
+    for (int k = 0; k < 16 + 8; k++) // wrap around the circle to find arcs crossing its start
+    {
+        int v = ptr[offsets[k & 15]];
+        runBrighter = v > upper ? runBrighter + 1 : 0;
+        runDarker = v < lower ? runDarker + 1 : 0;
+        if (runBrighter >= 9 || runDarker >= 9)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// FAST-9 corner detector with a vectorized segment test which checks 32 pixels per AVX2 instruction (a scalar
+// path is used without AVX2 and for the remaining pixels of each row). The threshold may vary over the image :
+// if thresholdGrid (CV_8U) is given, each of its cells holds the threshold of the corresponding image region,
+// otherwise `threshold` applies everywhere. Non-maximum suppression keeps corners whose score is strictly
+// larger than the scores of all 8 neighbours, as cv::FastFeatureDetector does.
+void detectFastSimd(std::vector<cv::KeyPoint> &keypoints, const cv::Mat &img, int threshold, bool bNMS, const cv::Mat &thresholdGrid)
+{
+    CV_Assert(img.type() == CV_8UC1);
+    const int border = 3;
+    if (img.rows <= 2 * border || img.cols <= 2 * border)
+    {
+        return;
+    }
+
+    int offsets[16];
+    int step = (int)img.step;
+    for (int k = 0; k < 16; k++)
+    {
+        offsets[k] = fastCircle[k][1] * step + fastCircle[k][0];
+    }
+
+    // corner scores, 0 where the segment test failed
+    cv::Mat scores = cv::Mat::zeros(img.size(), CV_8UC1);
+    vector<cv::Point> corners;
+
+    vector<uchar> thrRow(img.cols, (uchar)min(255, max(0, threshold)));
+    int gridRow = -1;
+
+    for (int y = border; y < img.rows - border; y++)
+    {
+        const uchar *row = img.ptr<uchar>(y);
+        uchar *scoreRow = scores.ptr<uchar>(y);
+
+        // per-pixel thresholds of this row, only rebuilt when entering a new row of grid cells
+        if (!thresholdGrid.empty() && gridRow != y * thresholdGrid.rows / img.rows)
+        {
+            gridRow = y * thresholdGrid.rows / img.rows;
+            const uchar *grid = thresholdGrid.ptr<uchar>(gridRow);
+            for (int x = 0; x < img.cols; x++)
+            {
+                thrRow[x] = grid[x * thresholdGrid.cols / img.cols];
+            }
+        }
+
+        int x = border;
+#ifdef __AVX2__
+        const __m256i signBit = _mm256_set1_epi8((char)0x80);
+        const __m256i runLength = _mm256_set1_epi8(8);
+        for (; x <= img.cols - border - 32; x += 32)
+        {
+            const uchar *ptr = row + x;
+            __m256i center = _mm256_loadu_si256((const __m256i *)ptr);
+            __m256i thr = _mm256_loadu_si256((const __m256i *)(thrRow.data() + x));
+            // unsigned comparisons are done as signed comparisons after flipping the sign bit
+            __m256i upper = _mm256_xor_si256(_mm256_adds_epu8(center, thr), signBit);
+            __m256i lower = _mm256_xor_si256(_mm256_subs_epu8(center, thr), signBit);
+
+            // quick rejection : an arc of 9 always covers two neighbouring compass points (0, 4, 8, 12)
+            __m256i brighter[4], darker[4];
+            for (int k = 0; k < 4; k++)
+            {
+                __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(ptr + offsets[4 * k])), signBit);
+                brighter[k] = _mm256_cmpgt_epi8(v, upper);
+                darker[k] = _mm256_cmpgt_epi8(lower, v);
+            }
+            __m256i candidates = _mm256_setzero_si256();
+            for (int k = 0; k < 4; k++)
+            {
+                candidates = _mm256_or_si256(candidates, _mm256_and_si256(brighter[k], brighter[(k + 1) & 3]));
+                candidates = _mm256_or_si256(candidates, _mm256_and_si256(darker[k], darker[(k + 1) & 3]));
+            }
+            if (_mm256_movemask_epi8(candidates) == 0)
+            {
+                continue;
+            }
+
+            // full segment test : track the current and the longest run of brighter / darker pixels per lane
+            __m256i runBrighter = _mm256_setzero_si256(), runDarker = _mm256_setzero_si256();
+            __m256i maxRun = _mm256_setzero_si256();
+            for (int k = 0; k < 16 + 8; k++)
+            {
+                __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(ptr + offsets[k & 15])), signBit);
+                __m256i isBrighter = _mm256_cmpgt_epi8(v, upper);
+                __m256i isDarker = _mm256_cmpgt_epi8(lower, v);
+                // masks are -1 where set, so subtracting them increments the run and and-ing resets it otherwise
+                runBrighter = _mm256_and_si256(_mm256_sub_epi8(runBrighter, isBrighter), isBrighter);
+                runDarker = _mm256_and_si256(_mm256_sub_epi8(runDarker, isDarker), isDarker);
+                maxRun = _mm256_max_epu8(maxRun, _mm256_max_epu8(runBrighter, runDarker));
+            }
+            unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpgt_epi8(maxRun, runLength), candidates));
+
+            while (mask)
+            {
+                int lane = __builtin_ctz(mask);
+                mask &= mask - 1;
+                scoreRow[x + lane] = (uchar)fastScore(ptr + lane, offsets);
+                corners.push_back(cv::Point(x + lane, y));
+            }
+        }
+#endif
+        for (; x < img.cols - border; x++)
+        {
+            if (fastSegmentTest(row + x, offsets, thrRow[x]))
+            {
+                scoreRow[x] = (uchar)fastScore(row + x, offsets);
+                corners.push_back(cv::Point(x, y));
+            }
+        }
+    }
+
+    // non-maximum suppression over the 3x3 neighbourhood
+    for (auto &pt : corners)
+    {
+        int score = scores.at<uchar>(pt.y, pt.x);
+        if (bNMS)
+        {
+            bool bMax = true;
+            for (int dy = -1; dy <= 1 && bMax; dy++)
+            {
+                const uchar *neighbours = scores.ptr<uchar>(pt.y + dy);
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    if ((dx != 0 || dy != 0) && neighbours[pt.x + dx] >= score)
+                    {
+                        bMax = false;
+                        break;
+                    }
+                }
+            }
+            if (!bMax)
+            {
+                continue;
+            }
+        }
+        keypoints.push_back(cv::KeyPoint((float)pt.x, (float)pt.y, 7.f, -1, (float)score));
+    }
+}
+
+// BRIEF sampling geometry : test points lie within a 48x48 patch and are smoothed over a 9x9 box
+static const int briefPatchSize = 48;
+static const int briefKernelSize = 9;
+
+// Test point pairs (x1, y1, x2, y2) relative to the keypoint, bit j of the descriptor being set when the box
+// around the first point is darker than the box around the second. This is the 32 byte pattern of OpenCV's
+// cv::xfeatures2d::BriefDescriptorExtractor (generated_32.i, where SMOOTHED takes y before x), in the same order
+static const int briefPattern[256][4] = {
+    {-1, -2, -1, 7}, {-1, -14, 3, -3}, {-2, 1, 2, 11}, {6, 1, -7, -10},
+    {2, 13, 0, -1}, {5, -14, -3, 5}, {8, -2, 4, 2}, {8, -11, 5, -15},
+    {-23, -6, -9, 8}, {6, -12, 8, -10}, {-1, -3, 1, 8}, {6, 3, 6, 5},
+    {-6, -7, -5, 5}, {-2, 22, -8, -11}, {7, 14, 5, 8}, {14, -1, -14, -5},
+    {9, -14, 0, 2}, {-3, 7, 6, 22}, {6, -6, -5, -8}, {9, -5, -1, 7},
+    {-7, -3, -18, -10}, {-5, 4, 11, 0}, {3, 2, 10, 9}, {3, -10, 9, 4},
+    {12, 0, 19, -3}, {15, 1, -5, -11}, {-1, 14, 8, 7}, {-23, 7, 5, -5},
+    {-6, 0, 17, -10}, {-4, 13, -4, -3}, {1, -12, 2, -12}, {8, 0, 22, 3},
+    {13, -13, -1, 3}, {17, -16, 10, 6}, {15, 7, 0, -5}, {-12, 2, -2, 19},
+    {-6, 3, -15, -4}, {3, 8, 14, 0}, {-11, 4, 5, 5}, {-7, 11, 1, 7},
+    {12, 6, 3, 21}, {2, -3, 1, 14}, {1, 5, 11, -5}, {-17, 3, 2, -6},
+    {8, 6, -10, 5}, {-2, -14, 4, 0}, {-7, 5, 5, -6}, {4, 10, -7, 4},
+    {0, 22, -18, 7}, {-3, -1, 18, 0}, {22, -4, 3, -5}, {-7, 1, -3, 2},
+    {-20, 19, -2, 17}, {-10, 3, 24, -8}, {-14, -5, 5, 7}, {12, -2, -15, -4},
+    {12, 4, -19, 0}, {13, 20, 5, 3}, {-12, -8, 0, 5}, {6, -5, -11, -7},
+    {-11, 6, -22, -3}, {4, 15, 1, 10}, {-4, -7, -6, 15}, {10, 5, 24, 0},
+    {6, 3, -2, 22}, {14, -13, -4, 4}, {8, -13, -22, -18}, {-1, -1, 3, -7},
+    {-12, -19, 3, 4}, {10, 8, -2, 13}, {-1, -6, -5, -6}, {-21, 2, 2, -3},
+    {-7, 4, 16, 0}, {-5, -6, -1, -12}, {-1, 1, 18, 9}, {10, -7, 6, -11},
+    {3, 4, -7, 19}, {5, -18, 5, -4}, {0, 4, 4, -20}, {-11, 7, 12, 18},
+    {17, -20, 7, -18}, {15, 2, -11, 19}, {6, -18, 3, -7}, {1, -4, 13, -14},
+    {3, 17, -8, 2}, {2, -7, 6, 1}, {-9, 17, 8, -2}, {-6, -8, 12, -1},
+    {4, -2, 6, -1}, {7, -2, 8, 6}, {-1, -8, -9, -7}, {-9, 8, 0, 15},
+    {22, 0, -15, -4}, {-1, -14, -2, 3}, {-4, -7, -7, 17}, {-2, -8, -4, 9},
+    {-7, 5, 7, 7}, {13, -5, 11, -8}, {-4, 11, 8, 0}, {-11, 5, -6, -9},
+    {-6, 2, -20, 3}, {2, -6, 10, 6}, {-6, -6, 7, -15}, {-3, -6, 1, 2},
+    {0, 11, 2, -3}, {-12, 7, 5, 14}, {-7, 0, -1, -1}, {0, -16, 8, 6},
+    {11, 22, -3, 0}, {0, 19, -17, 5}, {-14, -23, -19, -13}, {10, -8, -2, -11},
+    {6, -11, 13, -10}, {-7, 1, 0, 14}, {1, -12, -5, -5}, {7, 4, -1, 8},
+    {-5, -1, 2, 15}, {-1, -3, -10, 7}, {-6, 3, -18, 10}, {-13, -7, 10, -13},
+    {-1, 1, -10, 13}, {14, -19, -14, 8}, {-13, -4, 1, 7}, {-2, 1, -7, 12},
+    {-5, 3, -5, 1}, {-2, -2, -10, 8}, {14, 2, 7, 8}, {9, 3, 2, 8},
+    {1, -9, 0, -18}, {0, 4, 12, 1}, {9, 0, -10, -14}, {-9, -13, 6, -2},
+    {5, 1, 10, 10}, {-6, -3, -5, -16}, {6, 11, 0, -5}, {10, -23, 2, 1},
+    {-5, 13, 9, -3}, {-1, -4, -5, -13}, {13, 10, 8, -11}, {20, 19, 2, -9},
+    {-8, 4, -9, 0}, {10, -14, 19, 15}, {-12, -14, -3, -10}, {-3, -23, -2, 17},
+    {-11, -3, -14, 6}, {-2, 19, 2, -4}, {5, -5, -13, 3}, {-2, 2, 4, -5},
+    {4, 17, -11, 17}, {-2, -7, 23, 1}, {13, 8, -16, 1}, {-5, -13, -17, 1},
+    {6, 4, -3, -8}, {-9, -5, -10, -2}, {0, -9, -2, -7}, {0, 5, 2, 5},
+    {-16, -4, 3, 6}, {-15, 2, 12, -2}, {-1, 4, 2, 6}, {1, 1, -8, -2},
+    {12, -2, -2, -5}, {8, -8, 9, -9}, {-10, 2, 1, 3}, {10, -4, 4, -9},
+    {12, 6, 5, 2}, {-8, -3, 5, 0}, {1, -13, 2, -7}, {-10, -1, -18, 7},
+    {8, -1, -10, -9}, {-1, -23, 2, 6}, {-3, -5, 2, 3}, {11, 0, -7, -4},
+    {2, 15, -3, -10}, {-8, -20, 3, -13}, {-12, -19, -11, 5}, {-13, -17, 2, -3},
+    {4, 7, 0, -12}, {-1, 5, -6, -14}, {11, -4, -4, 0}, {10, 3, -3, 7},
+    {21, 13, 6, -11}, {24, -12, -4, -7}, {16, 4, -14, 3}, {5, -3, -12, -7},
+    {-4, 0, -5, 7}, {-9, -17, -7, 13}, {-6, 22, 5, -11}, {-8, 2, -11, 23},
+    {-10, 7, 14, -1}, {-10, -3, 3, 8}, {1, -13, 0, -6}, {-21, -7, -14, 6},
+    {19, 18, -6, -4}, {7, 10, -4, -1}, {21, -1, -5, 1}, {6, -10, -2, -11},
+    {-3, 18, 7, -1}, {-9, -3, 10, -5}, {14, -13, -3, 17}, {-19, 11, -18, -1},
+    {-2, 8, -23, -18}, {-5, 0, -9, -2}, {-11, -4, -8, 2}, {6, 14, -6, -3},
+    {0, -3, 0, -15}, {4, -9, -9, -15}, {11, -1, 11, 3}, {-16, -10, 7, -7},
+    {-10, -2, -2, -10}, {-3, -5, -23, 5}, {-8, 13, -11, -15}, {11, -15, -6, 6},
+    {-3, -16, 2, -2}, {12, 6, 24, -16}, {0, -10, 11, 8}, {7, -7, -7, -19},
+    {16, 5, -3, 9}, {7, 9, -16, -7}, {2, 3, 9, -10}, {1, 21, 7, 8},
+    {0, 7, 17, 1}, {12, -8, 6, 9}, {-7, 11, -6, -8}, {0, 19, 3, 9},
+    {-7, 1, -11, -5}, {8, 0, 14, -2}, {-2, 12, -6, -15}, {12, 4, -21, 0},
+    {-4, 17, -7, -6}, {-9, -10, -7, -14}, {-10, -15, -14, -15}, {-5, -7, -12, 5},
+    {0, -4, -4, 15}, {2, 5, -23, -6}, {-21, -4, 4, -6}, {5, -10, 6, -15},
+    {-3, 4, 5, -1}, {19, -4, -4, -23}, {17, -4, -11, 13}, {12, 1, -14, 4},
+    {-6, -11, 10, -20}, {5, 4, 20, 3}, {-20, -8, 1, 3}, {9, -19, -3, 9},
+    {15, 18, -4, 11}, {16, 12, 7, 8}, {-8, -14, 9, -3}, {0, -6, -4, 2},
+    {-10, 1, 2, -1}, {-7, 8, 18, -6}, {12, 9, -23, -7}, {-6, 8, 2, 5},
+    {6, -9, -7, -12}, {-2, -1, 2, -7}, {9, 9, 15, 7}, {2, 6, 6, -6}
+};
+
+// Integral image offsets of the four box corners of a test point, as used by boxSum
+static void boxCornerOffsets(int dx, int dy, int step, int *corners)
+{
+    const int half = briefKernelSize / 2;
+    corners[0] = (dy + half + 1) * step + (dx + half + 1);
+    corners[1] = (dy + half + 1) * step + (dx - half);
+    corners[2] = (dy - half) * step + (dx + half + 1);
+    corners[3] = (dy - half) * step + (dx - half);
+}
+
+static inline int boxSum(const int *base, const int *corners)
+{
+    return base[corners[0]] - base[corners[1]] - base[corners[2]] + base[corners[3]];
+}
+
+void BriefSimdExtractor::compute(cv::InputArray image, std::vector<cv::KeyPoint> &keypoints, cv::OutputArray descriptors)
+{
+    cv::Mat img = image.getMat();
+    if (img.channels() > 1)
+    {
+        cv::cvtColor(img, img, cv::COLOR_BGR2GRAY);
+    }
+
+    // drop keypoints whose sampling boxes would leave the image; boxes are placed around the rounded keypoint
+    // position, so a point within half a pixel of the far border is dropped as well
+    const int border = briefPatchSize / 2 + briefKernelSize / 2;
+    cv::KeyPointsFilter::runByImageBorder(keypoints, img.size(), border);
+    keypoints.erase(remove_if(keypoints.begin(), keypoints.end(), [&](const cv::KeyPoint &kpt) {
+                        return (int)(kpt.pt.x + 0.5f) + border >= img.cols || (int)(kpt.pt.y + 0.5f) + border >= img.rows;
+                    }),
+                    keypoints.end());
+
+    cv::Mat sum;
+    cv::integral(img, sum, CV_32S);
+    int step = (int)(sum.step / sizeof(int));
+
+    // integral image offsets of the box corners of both points of every test
+    vector<int> testCorners(256 * 8);
+    for (int j = 0; j < 256; j++)
+    {
+        boxCornerOffsets(briefPattern[j][0], briefPattern[j][1], step, &testCorners[8 * j]);
+        boxCornerOffsets(briefPattern[j][2], briefPattern[j][3], step, &testCorners[8 * j + 4]);
+    }
+
+#ifdef __AVX2__
+    // the same offsets as gather indices, one array per point and corner, with lanes reversed within each group
+    // of 8 tests so that the first test of a byte ends up in its most significant bit as in OpenCV's BRIEF
+    vector<int> gatherOffsets(8 * 256);
+    for (int j = 0; j < 256; j++)
+    {
+        int lane = (j & ~7) + (7 - (j & 7));
+        for (int c = 0; c < 8; c++)
+        {
+            gatherOffsets[c * 256 + lane] = testCorners[8 * j + c];
+        }
+    }
+#endif
+
+    descriptors.create((int)keypoints.size(), descriptorSize(), CV_8U);
+    cv::Mat desc = descriptors.getMat();
+    for (size_t i = 0; i < keypoints.size(); i++)
+    {
+        int x = (int)(keypoints[i].pt.x + 0.5f), y = (int)(keypoints[i].pt.y + 0.5f);
+        const int *base = sum.ptr<int>(y) + x;
+        uchar *d = desc.ptr<uchar>((int)i);
+
+#ifdef __AVX2__
+        if (bUseSimd)
+        {
+            for (int k = 0; k < 32; k++)
+            {
+                __m256i sums[2];
+                for (int point = 0; point < 2; point++)
+                {
+                    const int *o = &gatherOffsets[point * 4 * 256 + 8 * k];
+                    __m256i c0 = _mm256_i32gather_epi32(base, _mm256_loadu_si256((const __m256i *)o), 4);
+                    __m256i c1 = _mm256_i32gather_epi32(base, _mm256_loadu_si256((const __m256i *)(o + 256)), 4);
+                    __m256i c2 = _mm256_i32gather_epi32(base, _mm256_loadu_si256((const __m256i *)(o + 512)), 4);
+                    __m256i c3 = _mm256_i32gather_epi32(base, _mm256_loadu_si256((const __m256i *)(o + 768)), 4);
+                    sums[point] = _mm256_add_epi32(_mm256_sub_epi32(_mm256_sub_epi32(c0, c1), c2), c3);
+                }
+                __m256i less = _mm256_cmpgt_epi32(sums[1], sums[0]);
+                d[k] = (uchar)_mm256_movemask_ps(_mm256_castsi256_ps(less));
+            }
+            continue;
+        }
+#endif
+        for (int j = 0; j < 32; j++)
+        {
+            d[j] = 0;
+        }
+        for (int j = 0; j < 256; j++)
+        {
+            bool bLess = boxSum(base, &testCorners[8 * j]) < boxSum(base, &testCorners[8 * j + 4]);
+            d[j / 8] |= (uchar)(bLess << (7 - j % 8));
+        }
+    }
+}
+
+// Squared L2 distance of two uint8 vectors, with 16 elements per AVX2 step widened to 16 bit and accumulated
+// in 32 bit by multiply-add; exact for any length below 2^15 elements
+int normL2SqrU8(const uchar *a, const uchar *b, int n)
+{
+    int j = 0, sum = 0;
+#ifdef __AVX2__
+    __m256i acc = _mm256_setzero_si256();
+    for (; j <= n - 16; j += 16)
+    {
+        __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(a + j)));
+        __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(b + j)));
+        __m256i diff = _mm256_sub_epi16(va, vb);
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(diff, diff));
+    }
+    __m128i acc128 = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    acc128 = _mm_add_epi32(acc128, _mm_shuffle_epi32(acc128, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc128 = _mm_add_epi32(acc128, _mm_shuffle_epi32(acc128, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = _mm_cvtsi128_si32(acc128);
+#endif
+    for (; j < n; j++)
+    {
+        int diff = (int)a[j] - (int)b[j];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// compiles to the popcnt instruction when built with POPCNT support (-mpopcnt, -msse4.2, -mavx2 ...)
+static inline int popcount64(uint64_t v)
+{
+    return __builtin_popcountll(v);
+}
+
+// Hamming distance of descriptors with a fixed number of 64 bit words (32 byte ORB / BRIEF, 64 byte BRISK / FREAK)
+template <int WORDS>
+struct HammingFixed
+{
+    int operator()(const uchar *a, const uchar *b) const
+    {
+        int dist = 0;
+        for (int w = 0; w < WORDS; w++)
+        {
+            uint64_t wa, wb;
+            memcpy(&wa, a + 8 * w, 8);
+            memcpy(&wb, b + 8 * w, 8);
+            dist += popcount64(wa ^ wb);
+        }
+        return dist;
+    }
+};
+
+// Hamming distance of descriptors of any length (e.g. 61 byte AKAZE)
+struct HammingAny
+{
+    int nBytes;
+    int operator()(const uchar *a, const uchar *b) const
+    {
+        int dist = 0, j = 0;
+        for (; j <= nBytes - 8; j += 8)
+        {
+            uint64_t wa, wb;
+            memcpy(&wa, a + j, 8);
+            memcpy(&wb, b + j, 8);
+            dist += popcount64(wa ^ wb);
+        }
+        for (; j < nBytes; j++)
+        {
+            dist += popcount64((uint64_t)(a[j] ^ b[j]));
+        }
+        return dist;
+    }
+};
+
+template <class Distance>
+static void hammingKnn(const cv::Mat &descSource, const cv::Mat &descRef, std::vector<cv::DMatch> &matches, double minDescDistRatio, Distance distance)
+{
+    const int queryBlock = 64;  // source rows sharing one pass over a block of reference rows
+    const int trainBlock = 256; // reference rows per block, 8 to 16 kB which stay in L1 cache for the whole query block
+    int nQuery = descSource.rows, nTrain = descRef.rows;
+    int nQueryBlocks = (nQuery + queryBlock - 1) / queryBlock;
+
+    vector<cv::DMatch> best(nQuery);
+    vector<uchar> bValid(nQuery, 0);
+    cv::parallel_for_(cv::Range(0, nQueryBlocks), [&](const cv::Range &range) {
+        for (int block = range.start; block < range.end; ++block)
+        {
+            int q0 = block * queryBlock, q1 = min(nQuery, q0 + queryBlock);
+            int best1[queryBlock], best2[queryBlock], bestIdx[queryBlock];
+            fill(best1, best1 + queryBlock, INT_MAX);
+            fill(best2, best2 + queryBlock, INT_MAX);
+            fill(bestIdx, bestIdx + queryBlock, -1);
+
+            for (int t0 = 0; t0 < nTrain; t0 += trainBlock)
+            {
+                int t1 = min(nTrain, t0 + trainBlock);
+                for (int q = q0; q < q1; ++q)
+                {
+                    // the two best distances of this query stay in registers while it scans the block
+                    const uchar *query = descSource.ptr<uchar>(q);
+                    int b1 = best1[q - q0], b2 = best2[q - q0], bi = bestIdx[q - q0];
+                    for (int t = t0; t < t1; ++t)
+                    {
+                        int dist = distance(query, descRef.ptr<uchar>(t));
+                        if (dist < b2)
+                        {
+                            if (dist < b1)
+                            {
+                                b2 = b1;
+                                b1 = dist;
+                                bi = t;
+                            }
+                            else
+                            {
+                                b2 = dist;
+                            }
+                        }
+                    }
+                    best1[q - q0] = b1;
+                    best2[q - q0] = b2;
+                    bestIdx[q - q0] = bi;
+                }
+            }
+
+            // ratio test inline; it needs a second neighbour, as for the two nearest neighbours of cv::BFMatcher
+            for (int q = q0; q < q1; ++q)
+            {
+                int b1 = best1[q - q0], b2 = best2[q - q0];
+                if (bestIdx[q - q0] >= 0 && (minDescDistRatio <= 0 || (b2 != INT_MAX && b1 < minDescDistRatio * b2)))
+                {
+                    best[q] = cv::DMatch(q, bestIdx[q - q0], (float)b1);
+                    bValid[q] = 1;
+                }
+            }
+        }
+    });
+
+    for (int q = 0; q < nQuery; ++q)
+    {
+        if (bValid[q])
+        {
+            matches.push_back(best[q]);
+        }
+    }
+}
+
+// Brute force matching of binary descriptors with popcount Hamming distances. Query rows are processed in blocks
+// over blocks of reference rows for cache reuse and in parallel over the query blocks. Each query keeps its two
+// best distances, so the ratio test is applied without storing kNN lists; minDescDistRatio <= 0 returns the
+// nearest neighbour of every query instead. Matches are ordered by query index.
+void matchHammingKnn(const cv::Mat &descSource, const cv::Mat &descRef, std::vector<cv::DMatch> &matches, double minDescDistRatio)
+{
+    CV_Assert(descSource.type() == CV_8U && descRef.type() == CV_8U && descSource.cols == descRef.cols);
+    if (descSource.cols == 32)
+    {
+        hammingKnn(descSource, descRef, matches, minDescDistRatio, HammingFixed<4>());
+    }
+    else if (descSource.cols == 64)
+    {
+        hammingKnn(descSource, descRef, matches, minDescDistRatio, HammingFixed<8>());
+    }
+    else
+    {
+        HammingAny distance;
+        distance.nBytes = descSource.cols;
+        hammingKnn(descSource, descRef, matches, minDescDistRatio, distance);
+    }
+}
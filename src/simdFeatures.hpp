@@ -0,0 +1,37 @@
+
+#ifndef simdFeatures_hpp
+#define simdFeatures_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+
+void detectFastSimd(std::vector<cv::KeyPoint> &keypoints, const cv::Mat &img, int threshold, bool bNMS=true, const cv::Mat &thresholdGrid=cv::Mat());
+
+int normL2SqrU8(const uchar *a, const uchar *b, int n);
+void matchHammingKnn(const cv::Mat &descSource, const cv::Mat &descRef, std::vector<cv::DMatch> &matches, double minDescDistRatio);
+
+// BRIEF-256 descriptor extractor producing the same descriptors as cv::xfeatures2d::BriefDescriptorExtractor(32)
+// (same sampling pattern, 9x9 box smoothing on the integral image and bit order). The comparisons are evaluated eight
+// at a time with AVX2 gathers; the scalar path (used without AVX2 or when bUseSimd is false) is bit-identical.
+// Keypoint orientation is ignored, as for the reference. Keypoints which round onto the last border pixel, whose
+// boxes the reference would read from outside the integral image, are dropped.
+class BriefSimdExtractor : public cv::Feature2D
+{
+  public:
+    explicit BriefSimdExtractor(bool useSimd = true) : bUseSimd(useSimd) {}
+    static cv::Ptr<BriefSimdExtractor> create(bool useSimd = true) { return cv::makePtr<BriefSimdExtractor>(useSimd); }
+
+    using cv::Feature2D::compute;
+    void compute(cv::InputArray image, std::vector<cv::KeyPoint> &keypoints, cv::OutputArray descriptors) override;
+
+    int descriptorSize() const override { return 32; }
+    int descriptorType() const override { return CV_8U; }
+    int defaultNorm() const override { return cv::NORM_HAMMING; }
+
+  private:
+    bool bUseSimd;
+};
+
+#endif /* simdFeatures_hpp */
@@ -0,0 +1,168 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "trackManager.hpp"
+
+using namespace std;
+
+static const double reacquireMinIoU = 0.5; // min. overlap of an unassociated box with the last box of a lost track of its class
+
+static double intersectionOverUnion(const cv::Rect &a, const cv::Rect &b)
+{
+    int unionArea = (a | b).area();
+    return unionArea > 0 ? (double)(a & b).area() / unionArea : 0.0;
+}
+
+TrackManager::TrackManager(int maxMissedFrames, size_t maxHistory)
+    : maxMissedFrames(maxMissedFrames), maxHistory(maxHistory), nextTrackID(0)
+{
+}
+
+Track *TrackManager::find(int trackID)
+{
+    auto it = trackIndex.find(trackID);
+    return it != trackIndex.end() ? &trackList[it->second] : nullptr;
+}
+
+void TrackManager::observe(Track &track, BoundingBox &box, DataFrame &frame, int frameIndex)
+{
+    box.trackID = track.trackID;
+    track.classID = box.classID;
+    track.roi = box.roi;
+    track.lastFrame = frameIndex;
+    track.missedFrames = 0;
+    track.minLidarX = numeric_limits<double>::quiet_NaN();
+    for (uint32_t idx : box.lidarPointIndices)
+    {
+        double x = frame.lidarPoints[idx].x;
+        track.minLidarX = std::isnan(track.minLidarX) ? x : min(track.minLidarX, x);
+    }
+}
+
+void TrackManager::startTrack(BoundingBox &box, int boxIdx, DataFrame &frame, int frameIndex, bool bCurrent)
+{
+    Track track;
+    track.trackID = nextTrackID++;
+    track.prevBoxIdx = bCurrent ? -1 : boxIdx;
+    track.currBoxIdx = bCurrent ? boxIdx : -1;
+    track.firstFrame = frameIndex;
+    observe(track, box, frame, frameIndex);
+    trackIndex[track.trackID] = trackList.size();
+    trackList.push_back(track);
+}
+
+void TrackManager::update(DataFrame &prevFrame, DataFrame &currFrame, std::map<int, int> &bbMatches, int prevFrameIndex, int currFrameIndex)
+{
+    // the current frame of the last update is the previous frame now
+    for (auto &track : trackList)
+    {
+        track.prevBoxIdx = track.currBoxIdx;
+        track.currBoxIdx = -1;
+    }
+    for (size_t b = 0; b < prevFrame.boundingBoxes.size(); ++b)
+    { // e.g. the first frame, or boxes of dropped tracks
+        BoundingBox &box = prevFrame.boundingBoxes[b];
+        if (find(box.trackID) == nullptr)
+        {
+            startTrack(box, (int)b, prevFrame, prevFrameIndex, false);
+        }
+    }
+
+    unordered_map<int, int> prevBoxIdx, currBoxIdx; // boxID -> index into boundingBoxes
+    for (size_t b = 0; b < prevFrame.boundingBoxes.size(); ++b)
+    {
+        prevBoxIdx[prevFrame.boundingBoxes[b].boxID] = (int)b;
+    }
+    for (size_t b = 0; b < currFrame.boundingBoxes.size(); ++b)
+    {
+        currBoxIdx[currFrame.boundingBoxes[b].boxID] = (int)b;
+        currFrame.boundingBoxes[b].trackID = -1;
+    }
+
+    // continue tracks along the box associations; a current box claimed by several previous boxes continues the first
+    for (auto &bbMatch : bbMatches)
+    {
+        auto prevIt = prevBoxIdx.find(bbMatch.first);
+        auto currIt = currBoxIdx.find(bbMatch.second);
+        if (prevIt == prevBoxIdx.end() || currIt == currBoxIdx.end())
+        {
+            continue;
+        }
+        BoundingBox &currBox = currFrame.boundingBoxes[currIt->second];
+        Track *track = find(prevFrame.boundingBoxes[prevIt->second].trackID);
+        if (track != nullptr && track->currBoxIdx < 0 && currBox.trackID < 0)
+        {
+            track->currBoxIdx = currIt->second;
+            observe(*track, currBox, currFrame, currFrameIndex);
+        }
+    }
+
+    // remaining boxes either reacquire a track of the same class at about the same place, or start a new one. Only
+    // tracks missed in the previous frame can be reacquired : a track observed there, which bbMatches did not carry
+    // forward, was rejected by the box association and must not form a TTC pair with a current box.
+    for (size_t b = 0; b < currFrame.boundingBoxes.size(); ++b)
+    {
+        BoundingBox &box = currFrame.boundingBoxes[b];
+        if (box.trackID >= 0)
+        {
+            continue;
+        }
+        Track *best = nullptr;
+        double bestIoU = reacquireMinIoU;
+        for (auto &track : trackList)
+        {
+            double iou = intersectionOverUnion(track.roi, box.roi);
+            if (track.prevBoxIdx < 0 && track.currBoxIdx < 0 && track.classID == box.classID && iou >= bestIoU)
+            {
+                best = &track;
+                bestIoU = iou;
+            }
+        }
+        if (best != nullptr)
+        {
+            best->currBoxIdx = (int)b;
+            observe(*best, box, currFrame, currFrameIndex);
+        }
+        else
+        {
+            startTrack(box, (int)b, currFrame, currFrameIndex, true);
+        }
+    }
+
+    // age out tracks which were missed too often, by moving the last track into their slot
+    for (size_t i = 0; i < trackList.size();)
+    {
+        Track &track = trackList[i];
+        if (track.currBoxIdx < 0 && ++track.missedFrames > maxMissedFrames)
+        {
+            trackIndex.erase(track.trackID);
+            if (i + 1 < trackList.size())
+            {
+                track = std::move(trackList.back());
+                trackIndex[track.trackID] = i;
+            }
+            trackList.pop_back();
+            continue;
+        }
+        ++i;
+    }
+    cout << "Tracks : " << trackList.size() << " alive, next ID " << nextTrackID << endl;
+}
+
+void TrackManager::addTtc(int trackID, double ttcLidar, double ttcCamera)
+{
+    Track *track = find(trackID);
+    if (track == nullptr)
+    {
+        return;
+    }
+    track->ttcLidar.push_back(ttcLidar);
+    track->ttcCamera.push_back(ttcCamera);
+    while (track->ttcLidar.size() > maxHistory)
+    {
+        track->ttcLidar.pop_front();
+        track->ttcCamera.pop_front();
+    }
+}
@@ -0,0 +1,58 @@
+
+#ifndef trackManager_hpp
+#define trackManager_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <opencv2/core.hpp>
+
+#include "dataStructures.h"
+
+struct Track { // object followed across frames through the bounding box associations
+
+    int trackID;              // unique identifier, also stored in BoundingBox::trackID of every box of the track
+    int classID;              // class of the last observed box
+    cv::Rect roi;             // last observed box in image coordinates
+    int prevBoxIdx;           // index into the boundingBoxes of the previous frame, -1 if not observed there
+    int currBoxIdx;           // index into the boundingBoxes of the current frame, -1 if not observed there
+    int firstFrame;           // image index of the first observation
+    int lastFrame;            // image index of the last observation
+    int missedFrames;         // consecutive frames without observation
+    double minLidarX;         // closest Lidar point in driving direction at the last observation, NaN without points
+    std::deque<double> ttcLidar, ttcCamera; // TTC history, oldest first
+};
+
+// Keeps object tracks alive across frames. Each update continues the tracks of the previous boxes along bbMatches,
+// lets the remaining current boxes reacquire a track of their class missed in the previous frame by overlap or start
+// a new one, and
+// drops tracks which were missed in more than maxMissedFrames consecutive frames, so memory stays bounded by the
+// number of visible objects. Tracks are stored contiguously and found by trackID in O(1); pointers and references
+// to tracks are invalidated by the next update.
+class TrackManager
+{
+  public:
+    TrackManager(int maxMissedFrames = 2, size_t maxHistory = 20);
+
+    // prevFrameIndex and currFrameIndex are the image indices of both frames, which differ by the image step width
+    void update(DataFrame &prevFrame, DataFrame &currFrame, std::map<int, int> &bbMatches, int prevFrameIndex, int currFrameIndex);
+    void addTtc(int trackID, double ttcLidar, double ttcCamera); // keeps the last maxHistory values
+
+    Track *find(int trackID); // nullptr for unknown or dropped tracks
+    std::vector<Track> &tracks() { return trackList; }
+
+  private:
+    void startTrack(BoundingBox &box, int boxIdx, DataFrame &frame, int frameIndex, bool bCurrent);
+    void observe(Track &track, BoundingBox &box, DataFrame &frame, int frameIndex);
+
+    int maxMissedFrames;
+    size_t maxHistory;
+    int nextTrackID;
+
+    std::vector<Track> trackList;
+    std::unordered_map<int, size_t> trackIndex; // trackID -> position in trackList
+};
+
+#endif /* trackManager_hpp */